@@ -0,0 +1,56 @@
+/*
+ * ADC.h - Host replacement of the Teensy ADC library
+ *
+ * ADC0 converts CH1 (A0) and ADC1 converts CH2 (A1). A conversion returns
+ * the input of the simulated time at which it was started, so readSingle()
+ * in the sample interrupt gets the value of the previous interrupt, like
+ * on the target. The ADC timers are sample clocks of the simulation that
+ * start DMA transfers (see DMAChannel.h).
+ */
+
+#ifndef ADC_h
+#define ADC_h
+
+#include "Arduino.h"
+
+enum class ADC_CONVERSION_SPEED { VERY_LOW_SPEED, LOW_SPEED, MED_SPEED, HIGH_SPEED, VERY_HIGH_SPEED };
+enum class ADC_SAMPLING_SPEED { VERY_LOW_SPEED, LOW_SPEED, MED_SPEED, HIGH_SPEED, VERY_HIGH_SPEED };
+
+class ADC_Module
+{
+    public:
+        ADC_Module(uint8_t num);
+        void setResolution(uint8_t bits);
+        void setConversionSpeed(ADC_CONVERSION_SPEED speed) {}
+        void setSamplingSpeed(ADC_SAMPLING_SPEED speed) {}
+        void setAveraging(uint8_t num) {}
+        bool isConverting() { return false; }
+        bool startSingleRead(uint8_t pin);
+        int  readSingle() { return result; }
+        int  analogRead(uint8_t pin);
+        void enableDMA() {}
+        void disableDMA() {}
+        void startTimer(uint32_t freq);
+        void stopTimer();
+
+        // Simulation
+        void convert();
+
+        uint8_t  num;
+        uint8_t  bits;
+        uint16_t result;
+        uint64_t period;  // ns, 0 when the timer is stopped
+        uint64_t next;    // Next conversion started by the timer
+};
+
+class ADC
+{
+    public:
+        ADC();
+        bool startSynchronizedSingleRead(uint8_t pin0, uint8_t pin1);
+
+        ADC_Module *adc0;
+        ADC_Module *adc1;
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Arduino.h - Host replacement of the Arduino / Teensyduino core
+ *
+ * Only the parts used by the TeensyScope firmware are provided.
+ * The pins are kept in an array, the GPIO ports of the LCD data lines are
+ * plain memory that is decoded by the LCD model (see lcd_sim.h) on every
+ * rising edge of the WR pin. Time is the simulated time of the harness,
+ * it only moves when the harness advances it (see hal.h).
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+typedef uint8_t  byte;
+typedef uint16_t word;
+typedef bool     boolean;
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0
+#define OUTPUT  1
+
+#define PROGMEM
+#define DMAMEM
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+
+#define F_CPU_ACTUAL  600000000
+#define ARM_DWT_CYCCNT  (hal_cycles())
+
+extern volatile uint32_t SCB_AIRCR;
+
+/*
+ * Pins
+ */
+#define HAL_PINS  42
+
+extern uint8_t hal_pin[HAL_PINS];
+extern uint8_t hal_wr_pin;
+extern bool    hal_lcd_decode;
+
+void hal_lcd_strobe();
+
+struct digital_pin_bitband_and_config_table_struct
+{
+    volatile uint32_t *reg;
+    volatile uint32_t *mux;
+    volatile uint32_t *pad;
+    uint32_t mask;
+};
+
+extern const struct digital_pin_bitband_and_config_table_struct digital_pin_to_info_PGM[HAL_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode);
+
+/*
+ * A rising edge on the WR pin latches the data lines into the LCD model
+ */
+static inline void digitalWriteFast(uint8_t pin, uint8_t val)
+{
+    if(val && !hal_pin[pin] && (pin == hal_wr_pin) && hal_lcd_decode) {
+        hal_lcd_strobe();
+    }
+    hal_pin[pin] = val ? 1 : 0;
+}
+
+static inline uint8_t digitalReadFast(uint8_t pin)
+{
+    return hal_pin[pin];
+}
+
+static inline void digitalWrite(uint8_t pin, uint8_t val)
+{
+    digitalWriteFast(pin, val);
+}
+
+static inline uint8_t digitalRead(uint8_t pin)
+{
+    return hal_pin[pin];
+}
+
+/*
+ * Time
+ */
+uint32_t millis();
+uint32_t micros();
+uint32_t hal_cycles();
+
+static inline void delay(uint32_t ms) {}
+static inline void delayMicroseconds(uint32_t us) {}
+static inline void delayNanoseconds(uint32_t ns) {}
+
+static inline void arm_dcache_delete(void *addr, uint32_t size) {}
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+/*
+ * USB serial, the output goes to stdout (or the file set by the harness) and
+ * the input comes from the commands given to the harness.
+ * availableForWrite() models the transmit buffer that is emptied at the
+ * USB bandwidth, see hal.h.
+ */
+class usb_serial_class
+{
+    public:
+        void   begin(uint32_t baud) {}
+        int    available();
+        int    read();
+        int    availableForWrite();
+        size_t write(const uint8_t *buf, size_t len);
+        void   print(const char *s);
+        void   println(const char *s = "");
+        int    printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern usb_serial_class Serial;
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * DMAChannel.h - Host replacement of the Teensy DMAChannel
+ *
+ * A channel copies one element from its source to the next position of its
+ * destination buffer for every conversion of the ADC it is triggered by, or
+ * after every transfer of the channel it is linked to. CITER counts down and
+ * is reloaded at the end of the buffer, as on the target.
+ */
+
+#ifndef DMAChannel_h
+#define DMAChannel_h
+
+#include "Arduino.h"
+
+#define DMAMUX_SOURCE_ADC1  24
+#define DMAMUX_SOURCE_ADC2  88
+
+#define HAL_DMA_CHANNELS    8
+
+extern volatile uint16_t hal_adc_result[2];  // Result registers, 16 bits wide on the host
+
+#define ADC1_R0  (hal_adc_result[0])
+#define ADC2_R0  (hal_adc_result[1])
+
+typedef struct hal_tcd_s
+{
+    volatile uint16_t CITER_ELINKNO;
+} hal_tcd_t;
+
+class DMAChannel
+{
+    public:
+        DMAChannel() : TCD(&tcd) {}
+        void begin();
+        void source(volatile uint8_t &p)  { src = &p; size = 1; }
+        void source(volatile uint16_t &p) { src = &p; size = 2; }
+        void destinationBuffer(volatile uint8_t *p, unsigned int len)  { dst = p; count = len; }
+        void destinationBuffer(volatile uint16_t *p, unsigned int len) { dst = p; count = len / 2; }
+        void triggerAtHardwareEvent(uint8_t source) { event = source; }
+        void triggerAtTransfersOf(DMAChannel &ch) { link = &ch; }
+        void interruptAtHalf() { irq_half = true; }
+        void interruptAtCompletion() { irq_complete = true; }
+        void attachInterrupt(void (*fn)()) { isr = fn; }
+        void clearInterrupt() {}
+        void enable();
+        void disable();
+
+        hal_tcd_t *TCD;
+
+        // Simulation
+        void transfer();
+
+    private:
+        hal_tcd_t tcd;
+        volatile void *src = 0;
+        volatile void *dst = 0;
+        uint8_t  size = 0;
+        uint32_t count = 0;
+        uint32_t pos = 0;
+        uint8_t  event = 0;
+        DMAChannel *link = 0;
+        bool     irq_half = false;
+        bool     irq_complete = false;
+        void   (*isr)() = 0;
+        bool     enabled = false;
+
+        friend void hal_dma_event(uint8_t source);
+};
+
+void hal_dma_event(uint8_t source);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * EEPROM.h - Host replacement of the Teensy EEPROM, erased at startup
+ */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define HAL_EEPROM_SIZE  4284  // Teensy 4.1
+
+extern uint8_t hal_eeprom[HAL_EEPROM_SIZE];
+
+class EEPROMClass
+{
+    public:
+        template <typename T> T &get(int idx, T &t)
+        {
+            memcpy(&t, &hal_eeprom[idx], sizeof(T));
+            return t;
+        }
+        template <typename T> const T &put(int idx, const T &t)
+        {
+            memcpy(&hal_eeprom[idx], &t, sizeof(T));
+            return t;
+        }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
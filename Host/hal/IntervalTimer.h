@@ -0,0 +1,30 @@
+/*
+ * IntervalTimer.h - Host replacement of the Teensy IntervalTimer
+ *
+ * The callback is called by hal_advance() at the simulated times.
+ */
+
+#ifndef IntervalTimer_h
+#define IntervalTimer_h
+
+#include "Arduino.h"
+
+class IntervalTimer
+{
+    public:
+        ~IntervalTimer() { end(); }
+        bool begin(void (*fn)(), uint32_t us) { return start(fn, us * 1000ULL); }
+        bool begin(void (*fn)(), int us) { return start(fn, us * 1000ULL); }
+        bool begin(void (*fn)(), float us) { return start(fn, (uint64_t)(us * 1000.0f)); }
+        void end();
+
+        // Simulation
+        void (*fn)() = 0;
+        uint64_t period = 0;  // ns, 0 when the timer is stopped
+        uint64_t next = 0;
+
+    private:
+        bool start(void (*fn)(), uint64_t ns);
+};
+
+#endif
@@ -0,0 +1,5 @@
+/*
+ * arduino.h - cli.cpp includes the core with a lower case name
+ */
+
+#include "Arduino.h"
@@ -0,0 +1,468 @@
+/*
+ * hal.cpp - Host replacement of the Teensyduino core and libraries
+ */
+
+#include <stdarg.h>
+#include <time.h>
+#include <string>
+#include "Arduino.h"
+#include "ADC.h"
+#include "IntervalTimer.h"
+#include "DMAChannel.h"
+#include "EEPROM.h"
+#include "hal.h"
+
+#define HAL_GPIO_PORTS   5   // GPIO6..GPIO9 and a port for the pins that are not modelled
+#define HAL_GPIO_WORDS   64  // Covers DR, PSR, DR_SET and DR_CLEAR
+#define HAL_GPIO_PSR     2   // Words after DR
+#define HAL_MAX_TIMERS   4
+#define HAL_ADC_MODULES  2
+
+/*
+ * Pins
+ * The GPIO port and bit of each pin are those of the Teensy 4.1 so the LCD
+ * data lines are spread over the same 4 ports as on the target.
+ */
+uint8_t hal_pin[HAL_PINS];
+
+static volatile uint32_t gpio[HAL_GPIO_PORTS][HAL_GPIO_WORDS];
+
+#define PIN(port, bit)  {&gpio[port][0], 0, 0, 1UL << (bit)}
+
+const struct digital_pin_bitband_and_config_table_struct digital_pin_to_info_PGM[HAL_PINS] = {
+    PIN(0, 3),  PIN(0, 2),  PIN(3, 4),  PIN(3, 5),  PIN(3, 6),  PIN(3, 8),  PIN(1, 10), PIN(1, 17), // 0..7
+    PIN(1, 16), PIN(1, 11), PIN(1, 0),  PIN(1, 2),  PIN(1, 1),  PIN(1, 3),  PIN(0, 18), PIN(0, 19), // 8..15
+    PIN(0, 23), PIN(0, 22), PIN(0, 17), PIN(0, 16), PIN(0, 26), PIN(0, 27), PIN(0, 24), PIN(0, 25), // 16..23
+    PIN(0, 12), PIN(0, 13), PIN(0, 30), PIN(0, 31), PIN(2, 18), PIN(3, 31), PIN(2, 23), PIN(2, 22), // 24..31
+    PIN(1, 12), PIN(3, 7),  PIN(1, 29), PIN(1, 28), PIN(1, 18), PIN(1, 19), PIN(0, 28), PIN(0, 29), // 32..39
+    PIN(0, 20), PIN(0, 21)                                                                          // 40..41
+};
+
+volatile uint32_t SCB_AIRCR;
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+/*
+ * Set a digital input, also in the pad status register that is copied by DMA
+ */
+static void set_input_pin(uint8_t pin, uint8_t val)
+{
+    volatile uint32_t *psr = digital_pin_to_info_PGM[pin].reg + HAL_GPIO_PSR;
+
+    hal_pin[pin] = val ? 1 : 0;
+    if(val) {
+        *psr |= digital_pin_to_info_PGM[pin].mask;
+    } else {
+        *psr &= ~digital_pin_to_info_PGM[pin].mask;
+    }
+}
+
+/*
+ * Time
+ */
+static uint64_t now;         // Simulated time in ns
+static uint64_t now_wall;     // Wall clock time when the simulated time was last set
+static uint64_t isr_overhead; // Wall clock time of an empty hal_call_isr()
+
+uint64_t hal_now()
+{
+    return now;
+}
+
+uint64_t hal_wall_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uint32_t millis()
+{
+    return now / 1000000;
+}
+
+uint32_t micros()
+{
+    return now / 1000;
+}
+
+static void set_now(uint64_t t)
+{
+    now = t;
+    now_wall = hal_wall_ns();
+}
+
+/*
+ * The cycle counter is the simulated time plus the wall clock time since
+ * the simulated time was last set. Interrupts are timestamped at their
+ * simulated time, while the difference of two readings in the same piece
+ * of code is the wall clock time, so on target benchmarks like "beam bench"
+ * measure the host.
+ */
+uint32_t hal_cycles()
+{
+    return (now + hal_wall_ns() - now_wall) * (F_CPU_ACTUAL / 1000000) / 1000;
+}
+
+/*
+ * Serial
+ */
+usb_serial_class Serial;
+bool hal_serial_quiet;
+FILE *hal_serial_out;
+static std::string serial_in;
+static uint64_t tx_time;  // Simulated time of tx_free
+static uint64_t tx_free = HAL_USB_TX_SIZE;
+
+static FILE *serial_out()
+{
+    return hal_serial_out ? hal_serial_out : stdout;
+}
+
+void hal_serial_input(const char *s)
+{
+    serial_in += s;
+}
+
+int usb_serial_class::available()
+{
+    return serial_in.size();
+}
+
+int usb_serial_class::read()
+{
+    int c;
+
+    if(serial_in.empty()) return -1;
+    c = (uint8_t)serial_in[0];
+    serial_in.erase(0, 1);
+    return c;
+}
+
+/*
+ * The transmit buffer is emptied at HAL_USB_RATE
+ */
+int usb_serial_class::availableForWrite()
+{
+    tx_free += (now - tx_time) * HAL_USB_RATE / 1000000000ULL;
+    if(tx_free > HAL_USB_TX_SIZE) tx_free = HAL_USB_TX_SIZE;
+    tx_time = now;
+    return tx_free;
+}
+
+static void tx_used(size_t len)
+{
+    tx_free = (len < tx_free) ? tx_free - len : 0;
+}
+
+size_t usb_serial_class::write(const uint8_t *buf, size_t len)
+{
+    tx_used(len);
+    if(!hal_serial_quiet) fwrite(buf, 1, len, serial_out());
+    return len;
+}
+
+void usb_serial_class::print(const char *s)
+{
+    tx_used(strlen(s));
+    if(!hal_serial_quiet) fputs(s, serial_out());
+}
+
+void usb_serial_class::println(const char *s)
+{
+    print(s);
+    print("\n");
+}
+
+int usb_serial_class::printf(const char *fmt, ...)
+{
+    va_list ap;
+    int n = 0;
+
+    if(!hal_serial_quiet) {
+        va_start(ap, fmt);
+        n = vfprintf(serial_out(), fmt, ap);
+        va_end(ap);
+    }
+    tx_used(n);
+    return n;
+}
+
+uint8_t hal_eeprom[HAL_EEPROM_SIZE]; // Erased by hal_init()
+EEPROMClass EEPROM;
+
+/*
+ * Inputs
+ */
+static hal_input_fn input_fn;
+static void        *input_ctx;
+static hal_input_t  input;
+
+void hal_set_input(hal_input_fn fn, void *ctx)
+{
+    input_fn = fn;
+    input_ctx = ctx;
+}
+
+static void update_inputs()
+{
+    if(!input_fn) return;
+    input_fn(now, &input, input_ctx);
+    set_input_pin(HAL_MODE_IC_PIN, input.mode_ic);
+    set_input_pin(HAL_MODE_OP_PIN, input.mode_op);
+}
+
+float hal_analog(uint8_t pin)
+{
+    return (pin == HAL_CH2_PIN) ? input.ch2 : input.ch1;
+}
+
+/*
+ * Interrupts
+ */
+hal_stats_t hal_stats;
+
+void hal_call_isr(void (*fn)())
+{
+    uint64_t t = hal_wall_ns();
+
+    now_wall = t; // The interrupt starts at its simulated time
+    fn();
+    t = hal_wall_ns() - t;
+    hal_stats.isr_ns += (t > isr_overhead) ? t - isr_overhead : 0;
+    hal_stats.isr_calls++;
+}
+
+static void empty_isr()
+{
+}
+
+/*
+ * Startup, runs before the constructors of the firmware
+ */
+__attribute__((constructor(101))) static void hal_init()
+{
+    memset(hal_eeprom, 0xff, sizeof(hal_eeprom));
+
+    // Measure the overhead of timing an interrupt function
+    isr_overhead = 0;
+    for(int i=0; i<100000; i++) {
+        hal_call_isr(empty_isr);
+    }
+    isr_overhead = hal_stats.isr_ns / hal_stats.isr_calls;
+    hal_stats.isr_ns = 0;
+    hal_stats.isr_calls = 0;
+}
+
+/*
+ * IntervalTimer
+ */
+static IntervalTimer *timers[HAL_MAX_TIMERS];
+
+bool IntervalTimer::start(void (*f)(), uint64_t ns)
+{
+    int i, free = -1;
+
+    for(i=0; i<HAL_MAX_TIMERS; i++) {
+        if(timers[i] == this) break;
+        if(!timers[i] && (free < 0)) free = i;
+    }
+    if(i == HAL_MAX_TIMERS) {
+        if(free < 0) return false;
+        timers[free] = this;
+    }
+    fn = f;
+    period = ns ? ns : 1;
+    next = now + period;
+    return true;
+}
+
+void IntervalTimer::end()
+{
+    for(int i=0; i<HAL_MAX_TIMERS; i++) {
+        if(timers[i] == this) timers[i] = 0;
+    }
+    period = 0;
+}
+
+/*
+ * ADC
+ */
+static ADC_Module *adc_modules[HAL_ADC_MODULES];
+volatile uint16_t hal_adc_result[2];
+
+ADC_Module::ADC_Module(uint8_t n)
+{
+    num = n;
+    bits = 10;
+    result = 0;
+    period = 0;
+    next = 0;
+    adc_modules[n] = this;
+}
+
+void ADC_Module::setResolution(uint8_t b)
+{
+    bits = b;
+}
+
+static uint16_t to_code(float v, uint8_t bits)
+{
+    int32_t code = (int32_t)(v / HAL_VREF * (1 << bits));
+
+    if(code < 0) code = 0;
+    if(code > (1 << bits) - 1) code = (1 << bits) - 1;
+    return code;
+}
+
+int ADC_Module::analogRead(uint8_t pin)
+{
+    return to_code(hal_analog(pin), bits);
+}
+
+bool ADC_Module::startSingleRead(uint8_t pin)
+{
+    convert();
+    return true;
+}
+
+void ADC_Module::convert()
+{
+    result = to_code(num ? input.ch2 : input.ch1, bits);
+    hal_adc_result[num] = result;
+}
+
+void ADC_Module::startTimer(uint32_t freq)
+{
+    period = 1000000000ULL / freq;
+    next = now + period;
+}
+
+void ADC_Module::stopTimer()
+{
+    period = 0;
+}
+
+ADC::ADC()
+{
+    adc0 = new ADC_Module(0);
+    adc1 = new ADC_Module(1);
+}
+
+bool ADC::startSynchronizedSingleRead(uint8_t pin0, uint8_t pin1)
+{
+    adc0->convert();
+    adc1->convert();
+    return true;
+}
+
+/*
+ * DMA
+ */
+static DMAChannel *dma_channels[HAL_DMA_CHANNELS];
+
+void DMAChannel::begin()
+{
+    for(int i=0; i<HAL_DMA_CHANNELS; i++) {
+        if(dma_channels[i] == this) return;
+    }
+    for(int i=0; i<HAL_DMA_CHANNELS; i++) {
+        if(!dma_channels[i]) {
+            dma_channels[i] = this;
+            return;
+        }
+    }
+}
+
+void DMAChannel::enable()
+{
+    pos = 0;
+    tcd.CITER_ELINKNO = count;
+    enabled = true;
+}
+
+void DMAChannel::disable()
+{
+    enabled = false;
+}
+
+void DMAChannel::transfer()
+{
+    bool irq;
+
+    if(size == 1) {
+        ((volatile uint8_t *)dst)[pos] = *(volatile uint8_t *)src;
+    } else {
+        ((volatile uint16_t *)dst)[pos] = *(volatile uint16_t *)src;
+    }
+    pos++;
+    irq = irq_half && (pos == count / 2);
+    if(pos == count) {
+        pos = 0;
+        irq |= irq_complete;
+    }
+    tcd.CITER_ELINKNO = count - pos;
+
+    for(int i=0; i<HAL_DMA_CHANNELS; i++) {
+        if(dma_channels[i] && dma_channels[i]->enabled && (dma_channels[i]->link == this)) {
+            dma_channels[i]->transfer();
+        }
+    }
+    if(irq && isr) {
+        hal_call_isr(isr);
+    }
+}
+
+void hal_dma_event(uint8_t source)
+{
+    for(int i=0; i<HAL_DMA_CHANNELS; i++) {
+        if(dma_channels[i] && dma_channels[i]->enabled && (dma_channels[i]->event == source)) {
+            dma_channels[i]->transfer();
+        }
+    }
+}
+
+/*
+ * Run the timers and ADC conversions up to time t
+ */
+void hal_advance(uint64_t t)
+{
+    for(;;) {
+        IntervalTimer *timer = 0;
+        ADC_Module *module = 0;
+        uint64_t next = t + 1;
+
+        for(int i=0; i<HAL_MAX_TIMERS; i++) {
+            if(timers[i] && timers[i]->period && (timers[i]->next < next)) {
+                timer = timers[i];
+                next = timer->next;
+            }
+        }
+        for(int i=0; i<HAL_ADC_MODULES; i++) {
+            if(adc_modules[i] && adc_modules[i]->period && (adc_modules[i]->next < next)) {
+                module = adc_modules[i];
+                timer = 0;
+                next = module->next;
+            }
+        }
+        if(next > t) {
+            break;
+        }
+        set_now(next);
+        update_inputs();
+        if(module) {
+            module->next += module->period;
+            module->convert();
+            hal_stats.conversions++;
+            hal_dma_event(module->num ? DMAMUX_SOURCE_ADC2 : DMAMUX_SOURCE_ADC1);
+        } else {
+            timer->next += timer->period;
+            hal_call_isr(timer->fn);
+        }
+    }
+    set_now(t);
+    update_inputs();
+}
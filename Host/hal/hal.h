@@ -0,0 +1,53 @@
+/*
+ * hal.h - Simulation interface of the host HAL
+ *
+ * The harness sets the analog and digital inputs with an input function
+ * and moves the simulated time forward with hal_advance(). This calls the
+ * IntervalTimer callbacks and does the ADC conversions and DMA transfers
+ * that are due, in order of their simulated time.
+ * The wall clock time spent in the interrupt functions is counted in hal_stats.
+ */
+
+#ifndef hal_h
+#define hal_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HAL_MODE_IC_PIN  3   // Digital inputs, as wired in TeensyScope.ino
+#define HAL_MODE_OP_PIN  4
+#define HAL_CH1_PIN      14  // A0
+#define HAL_CH2_PIN      15  // A1
+#define HAL_VREF         3.3f
+#define HAL_USB_TX_SIZE  8192      // Bytes in the USB serial transmit buffer
+#define HAL_USB_RATE     25000000  // Bytes per s the host takes from the USB serial port
+
+typedef struct hal_input_s
+{
+    float   ch1, ch2;  // Analog inputs in V
+    uint8_t mode_ic;   // Digital inputs
+    uint8_t mode_op;
+} hal_input_t;
+
+typedef void (*hal_input_fn)(uint64_t t, hal_input_t *in, void *ctx);
+
+typedef struct hal_stats_s
+{
+    uint64_t isr_calls;    // Interrupt functions called
+    uint64_t isr_ns;       // Wall clock time spent in the interrupt functions
+    uint64_t conversions;  // ADC conversions started by the ADC timers
+} hal_stats_t;
+
+extern hal_stats_t hal_stats;
+extern bool        hal_serial_quiet;
+extern FILE       *hal_serial_out;  // Serial output, stdout when not set
+
+void     hal_set_input(hal_input_fn fn, void *ctx);
+void     hal_advance(uint64_t t);
+uint64_t hal_now();
+uint64_t hal_wall_ns();
+void     hal_serial_input(const char *s);
+void     hal_call_isr(void (*fn)());
+float    hal_analog(uint8_t pin);
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * lcd_sim.cpp - Model of the ILI948x LCD controller on the 16 bits bus
+ */
+
+#include <stdio.h>
+#include "Arduino.h"
+#include "lcd_sim.h"
+
+/*
+ * Wiring of the LCD, as defined in MyLCD.cpp
+ */
+static const uint8_t db_pins[16] = {40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25};
+
+#define RS_PIN    12
+#define WR_PIN    24
+#define CS_PIN    41
+
+#define GPIO_DR_SET    (0x84/4)
+#define GPIO_DR_CLEAR  (0x88/4)
+
+uint8_t hal_wr_pin = WR_PIN;
+bool    hal_lcd_decode = true;
+
+lcd_sim_stats_t lcd_sim_stats;
+
+static uint16_t mem[LCD_SIM_PAGES][LCD_SIM_COLUMNS];
+
+static uint8_t  cmd;
+static int      nparam;
+static uint8_t  param[8];
+static int      sc, ec, sp, ep;   // Window
+static int      col, page;        // Write position
+static int      tfa, vsa, vsp;    // Vertical scrolling
+static bool     scrolling;
+
+/*
+ * Latch the data lines.
+ * lcd_bus_write() stores the set and clear masks of every port, they are
+ * applied to the port here.
+ */
+static uint16_t read_bus()
+{
+    uint16_t d = 0;
+
+    for(int i=0; i<16; i++) {
+        volatile uint32_t *reg = digital_pin_to_info_PGM[db_pins[i]].reg;
+
+        if(reg[GPIO_DR_SET] | reg[GPIO_DR_CLEAR]) {
+            reg[0] = (reg[0] | reg[GPIO_DR_SET]) & ~reg[GPIO_DR_CLEAR];
+            reg[GPIO_DR_SET] = 0;
+            reg[GPIO_DR_CLEAR] = 0;
+        }
+        if(reg[0] & digital_pin_to_info_PGM[db_pins[i]].mask) {
+            d |= 1 << i;
+        }
+    }
+    return d;
+}
+
+static void command(uint8_t c)
+{
+    cmd = c;
+    nparam = 0;
+    lcd_sim_stats.commands++;
+    switch(c) {
+        case 0x2c: // Memory Write
+            col = sc;
+            page = sp;
+            lcd_sim_stats.windows++;
+            break;
+        case 0x13: // Normal Display Mode ON, leaves the scroll mode
+            scrolling = false;
+            break;
+    }
+}
+
+static void data(uint16_t d)
+{
+    if(nparam < (int)sizeof(param)) {
+        param[nparam] = d & 0xff;
+    }
+    nparam++;
+
+    switch(cmd) {
+        case 0x2a: // Column Address Set
+            if(nparam == 4) {
+                sc = (param[0] << 8) | param[1];
+                ec = (param[2] << 8) | param[3];
+            }
+            break;
+        case 0x2b: // Page Address Set
+            if(nparam == 4) {
+                sp = (param[0] << 8) | param[1];
+                ep = (param[2] << 8) | param[3];
+            }
+            break;
+        case 0x2c: // Memory Write
+            if((page < LCD_SIM_PAGES) && (col < LCD_SIM_COLUMNS)) {
+                mem[page][col] = d;
+            }
+            lcd_sim_stats.pixels++;
+            if(++col > ec) {
+                col = sc;
+                if(++page > ep) page = sp;
+            }
+            break;
+        case 0x33: // Vertical Scrolling Definition
+            if(nparam == 6) {
+                tfa = (param[0] << 8) | param[1];
+                vsa = (param[2] << 8) | param[3];
+            }
+            break;
+        case 0x37: // Vertical Scrolling Start Address
+            if(nparam == 2) {
+                vsp = (param[0] << 8) | param[1];
+                scrolling = true;
+            }
+            break;
+    }
+}
+
+void hal_lcd_strobe()
+{
+    uint16_t d;
+
+    if(hal_pin[CS_PIN]) {
+        return;
+    }
+    d = read_bus();
+    if(hal_pin[RS_PIN]) {
+        data(d);
+    } else {
+        command(d & 0xff);
+    }
+}
+
+/*
+ * Color of pixel x,y of the display in landscape orientation (0,0 is the top left corner).
+ * A landscape column is a page of the LCD, the scroll area shows the
+ * pages from the vertical scrolling start address on.
+ */
+uint16_t lcd_sim_pixel(int x, int y)
+{
+    int p = LCD_SIM_PAGES - 1 - x;
+
+    if(scrolling && (vsa > 0) && (p >= tfa) && (p < tfa + vsa)) {
+        p = tfa + ((vsp - tfa) + (p - tfa) + vsa) % vsa;
+    }
+    return mem[p][y];
+}
+
+/*
+ * Write the display as a binary PPM image.
+ * Returns 0 when successful.
+ */
+int lcd_sim_write_ppm(const char *name)
+{
+    FILE *f = fopen(name, "wb");
+
+    if(!f) {
+        return -1;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", LCD_SIM_PAGES, LCD_SIM_COLUMNS);
+    for(int y=0; y<LCD_SIM_COLUMNS; y++) {
+        for(int x=0; x<LCD_SIM_PAGES; x++) {
+            uint16_t c = lcd_sim_pixel(x, y);
+            uint8_t rgb[3];
+
+            rgb[0] = ((c >> 11) & 0x1f) * 255 / 31;
+            rgb[1] = ((c >> 5) & 0x3f) * 255 / 63;
+            rgb[2] = (c & 0x1f) * 255 / 31;
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    return fclose(f);
+}
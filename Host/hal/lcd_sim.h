@@ -0,0 +1,32 @@
+/*
+ * lcd_sim.h - Model of the ILI948x LCD controller on the 16 bits bus
+ *
+ * Every rising edge of WR latches the data lines from the GPIO ports and
+ * handles it as a command (RS low) or data (RS high), as long as CS is low.
+ * The model knows the commands that MyLCD uses to write pixels and to
+ * scroll: column/page address set, memory write, vertical scrolling
+ * definition, vertical scrolling start address and normal display mode.
+ * lcd_sim_write_ppm() writes what the display shows in landscape orientation.
+ */
+
+#ifndef lcd_sim_h
+#define lcd_sim_h
+
+#include <stdint.h>
+
+#define LCD_SIM_COLUMNS  320
+#define LCD_SIM_PAGES    480
+
+typedef struct lcd_sim_stats_s
+{
+    uint64_t commands;  // Commands written
+    uint64_t windows;   // Memory writes started
+    uint64_t pixels;    // Pixels written
+} lcd_sim_stats_t;
+
+extern lcd_sim_stats_t lcd_sim_stats;
+
+uint16_t lcd_sim_pixel(int x, int y);
+int      lcd_sim_write_ppm(const char *name);
+
+#endif
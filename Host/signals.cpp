@@ -0,0 +1,85 @@
+/*
+ * signals.cpp - Synthetic THAT-like input signals for the host simulation
+ */
+
+#include <math.h>
+#include <string.h>
+#include "signals.h"
+
+#define MU_OFFSET  1.65f  // V at 0 machine units
+#define MU_SCALE   1.5f   // V per machine unit
+
+static const char *names[] = {"lissajous", "damped", "square"};
+
+void signal_init(signal_t *sig, uint8_t type)
+{
+    sig->type = type;
+    sig->freq = 200.0f;
+    sig->ratio = 1.5f;
+    sig->damping = 0.05f;
+    sig->op_time = 0.02f;
+    sig->ic_time = 0.005f;
+    sig->noise = 0.0f;
+    sig->seed = 0x12345678;
+}
+
+/*
+ * Signal type of a name, -1 when the name is not known
+ */
+int signal_type(const char *name)
+{
+    for(int i=0; i<(int)(sizeof(names)/sizeof(names[0])); i++) {
+        if(strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/*
+ * Uniform noise in -1..+1 (xorshift32)
+ */
+static float noise(signal_t *sig)
+{
+    uint32_t x = sig->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sig->seed = x;
+    return (float)x / 2147483648.0f - 1.0f;
+}
+
+/*
+ * Input function for hal_set_input()
+ */
+void signal_input(uint64_t t, hal_input_t *in, void *ctx)
+{
+    signal_t *sig = (signal_t *)ctx;
+    double s = t * 1e-9;
+    double period = sig->op_time + sig->ic_time;
+    double op = fmod(s, period);   // Time since the start of the OP period
+    double w = 2 * M_PI * sig->freq;
+    float  x, y;
+
+    in->mode_op = (op >= sig->op_time) ? 1 : 0;
+    in->mode_ic = !in->mode_op;
+
+    switch(sig->type) {
+        case SIGNAL_LISSAJOUS:
+            x = sin(w * s);
+            y = sin(w * sig->ratio * s);
+            break;
+        case SIGNAL_DAMPED:
+            if(in->mode_op) {
+                op = 0; // IC, hold the initial condition
+            }
+            x = exp(-sig->damping * w * op) * cos(w * op);
+            y = -exp(-sig->damping * w * op) * sin(w * op);
+            break;
+        default:
+            x = in->mode_op ? 1.0f : -1.0f;
+            y = 4 * fabs(fmod(s * sig->freq, 1.0) - 0.5) - 1;
+            break;
+    }
+    in->ch1 = MU_OFFSET + MU_SCALE * x + sig->noise * noise(sig);
+    in->ch2 = MU_OFFSET + MU_SCALE * y + sig->noise * noise(sig);
+}
@@ -0,0 +1,42 @@
+/*
+ * signals.h - Synthetic THAT-like input signals for the host simulation
+ *
+ * THAT runs in repetitive operation: ModeOP is low while the computer
+ * is in operate (OP) and high while the initial conditions are set (IC),
+ * ModeIC is the inverse. The analog outputs are in machine units (-1..+1),
+ * which are mapped to 0.15 .. 3.15 V at the ADC inputs.
+ *  - LISSAJOUS: free running sine waves on CH1 and CH2, the frequency of
+ *               CH2 is ratio times the frequency of CH1
+ *  - DAMPED:    a damped oscillator that starts from its initial condition
+ *               at the start of every OP period, CH1 is the position and CH2
+ *               the velocity so the XY display shows a spiral
+ *  - SQUARE:    the ModeOP signal on CH1 and a triangle wave on CH2
+ */
+
+#ifndef signals_h
+#define signals_h
+
+#include <stdint.h>
+#include "hal.h"
+
+#define SIGNAL_LISSAJOUS  0
+#define SIGNAL_DAMPED     1
+#define SIGNAL_SQUARE     2
+
+typedef struct signal_s
+{
+    uint8_t  type;
+    float    freq;      // Hz
+    float    ratio;     // LISSAJOUS: CH2 frequency / CH1 frequency
+    float    damping;   // DAMPED: damping ratio
+    float    op_time;   // s
+    float    ic_time;   // s
+    float    noise;     // Peak noise in V
+    uint32_t seed;      // State of the noise generator
+} signal_t;
+
+void signal_init(signal_t *sig, uint8_t type);
+int  signal_type(const char *name);
+void signal_input(uint64_t t, hal_input_t *in, void *sig);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * sim_main.cpp - Host simulation and benchmark harness for TeensyScope
+ *
+ * Runs the firmware on synthetic input signals for a given simulated time.
+ * The harness does what loop() does, but times the rasterizer and the
+ * display update separately. CLI commands can be given on the command
+ * line, they are handled at the start of the run as if they were typed,
+ * or at the end of the run (-e) to look at the state the run left.
+ *
+ * Reported are the wall clock times of the interrupt path (sample
+ * interrupt or DMA block interrupt) and the rasterizer per sample, and of
+ * the LCD push per frame. With -o the display is written as a PPM image
+ * at the end of the run, so the output of two builds can be compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "Arduino.h"
+#include "hal.h"
+#include "lcd_sim.h"
+#include "signals.h"
+#include "sample_ring.h"
+#include "src/MyLCD/LCDPush.h"
+
+/*
+ * The firmware, see sketch.cpp
+ */
+extern LCDPush       lcd_push;
+extern sample_ring_t sample_ring;
+
+void setup();
+void cli_loop();
+void rasterize();
+void display();
+void send_stream();
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: scope_sim [options]\n"
+        "  -s <lissajous|damped|square>  Input signal (default lissajous)\n"
+        "  -f <Hz>       Signal frequency (default 200)\n"
+        "  -r <ratio>    Lissajous frequency ratio CH2/CH1 (default 1.5)\n"
+        "  -d <ratio>    Damping ratio of the damped oscillator (default 0.05)\n"
+        "  -p <ms>       OP time of the repetitive operation (default 20)\n"
+        "  -i <ms>       IC time of the repetitive operation (default 5)\n"
+        "  -n <V>        Peak noise on the analog inputs (default 0)\n"
+        "  -t <s>        Simulated time (default 1)\n"
+        "  -l <us>       Simulated time between two passes through loop() (default 100)\n"
+        "  -c <command>  CLI command, can be given more than once, e.g. -c \"time 5ms\"\n"
+        "  -e <command>  CLI command handled at the end of the run, e.g. -e status\n"
+        "  -o <file>     Write the display as a PPM image at the end of the run\n"
+        "  -u <file>     Write the serial output to a file or pty instead of stdout\n"
+        "  -x            Do not decode the LCD bus (the image stays empty)\n"
+        "  -q            Do not show the serial output of the firmware\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    signal_t sig;
+    std::string end_cmds;
+    const char *ppm = 0;
+    double   sim_time = 1.0;
+    uint64_t loop_ns = 100000;
+    uint64_t end, t;
+    uint64_t raster_ns = 0, push_ns = 0, samples = 0, loops = 0;
+    uint64_t isr_ns, isr_calls, pixels;
+    uint32_t frames;
+    int opt, type;
+
+    signal_init(&sig, SIGNAL_LISSAJOUS);
+    while((opt = getopt(argc, argv, "s:f:r:d:p:i:n:t:l:c:e:o:u:xq")) != -1) {
+        switch(opt) {
+            case 's':
+                type = signal_type(optarg);
+                if(type < 0) usage();
+                sig.type = type;
+                break;
+            case 'f': sig.freq = atof(optarg); break;
+            case 'r': sig.ratio = atof(optarg); break;
+            case 'd': sig.damping = atof(optarg); break;
+            case 'p': sig.op_time = atof(optarg) / 1000; break;
+            case 'i': sig.ic_time = atof(optarg) / 1000; break;
+            case 'n': sig.noise = atof(optarg); break;
+            case 't': sim_time = atof(optarg); break;
+            case 'l': loop_ns = atof(optarg) * 1000; break;
+            case 'c':
+                hal_serial_input(optarg);
+                hal_serial_input("\n");
+                break;
+            case 'e':
+                end_cmds += optarg;
+                end_cmds += "\n";
+                break;
+            case 'o': ppm = optarg; break;
+            case 'u':
+                hal_serial_out = fopen(optarg, "wb");
+                if(!hal_serial_out) {
+                    fprintf(stderr, "Error: cannot open %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'x': hal_lcd_decode = false; break;
+            case 'q': hal_serial_quiet = true; break;
+            default:  usage();
+        }
+    }
+    if((sim_time <= 0) || (loop_ns == 0) || (sig.op_time + sig.ic_time <= 0)) {
+        usage();
+    }
+
+    hal_set_input(signal_input, &sig);
+    hal_advance(0);
+    setup();
+
+    // Only the run itself is measured, not the startup
+    hal_stats.isr_ns = 0;
+    hal_stats.isr_calls = 0;
+    lcd_sim_stats.pixels = 0;
+    frames = lcd_push.frames();
+
+    end = hal_now() + (uint64_t)(sim_time * 1e9);
+    for(t = hal_now(); t < end; ) {
+        uint64_t w0, w1, w2;
+        uint32_t tail;
+
+        t += loop_ns;
+        hal_advance(t);
+
+        cli_loop();
+        tail = sample_ring.tail.load();
+        w0 = hal_wall_ns();
+        rasterize();
+        w1 = hal_wall_ns();
+        display();
+        w2 = hal_wall_ns();
+        send_stream();
+
+        samples += sample_ring.tail.load() - tail;
+        raster_ns += w1 - w0;
+        push_ns += w2 - w1;
+        loops++;
+    }
+    hal_serial_input(end_cmds.c_str());
+    while(Serial.available()) {
+        cli_loop();
+    }
+    isr_ns = hal_stats.isr_ns;
+    isr_calls = hal_stats.isr_calls;
+    pixels = lcd_sim_stats.pixels;
+    frames = lcd_push.frames() - frames;
+
+    printf("\n%g s simulated, %llu loops, %llu samples, %u overruns\n", sim_time,
+           (unsigned long long)loops, (unsigned long long)samples, sample_ring.overruns.load());
+    if(samples) {
+        printf("interrupts: %llu calls, %8.1f ns/sample\n", (unsigned long long)isr_calls,
+               (double)isr_ns / samples);
+        printf("rasterize:  %8.1f ns/sample\n", (double)raster_ns / samples);
+    }
+    printf("display:    %8.1f us/loop", (double)push_ns / loops / 1000);
+    if(frames) {
+        printf(", %u frames, %8.1f us/frame", frames, (double)push_ns / frames / 1000);
+    }
+    if(hal_lcd_decode) {
+        printf(", %llu pixels written", (unsigned long long)pixels);
+    }
+    printf("\n");
+
+    if(ppm) {
+        if(!hal_lcd_decode) {
+            fprintf(stderr, "Error: the LCD bus is not decoded (-x), no image\n");
+            return 1;
+        }
+        if(lcd_sim_write_ppm(ppm) != 0) {
+            fprintf(stderr, "Error: cannot write %s\n", ppm);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,6 @@
+/*
+ * sketch.cpp - The firmware sketch, built as a C++ file for the host
+ */
+
+#include "Arduino.h"
+#include "TeensyScope.ino"
@@ -0,0 +1,148 @@
+/*
+ * stream_decode.cpp - Decoder of the binary sample stream of TeensyScope
+ *
+ * Reads the output of the stream command from the USB serial device (or a
+ * file, pipe or pty, e.g. written by scope_sim -u) and writes the samples as
+ * CSV or as binary sample_t records. Text between the frames, like the
+ * replies to CLI commands, is skipped. Gaps in the sample sequence and
+ * bytes that did not belong to a valid frame are reported at the end.
+ *
+ * The serial device must be in raw mode, e.g. stty -F /dev/ttyACM0 raw.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <vector>
+#include "stream.h"
+
+static void usage()
+{
+    fprintf(stderr,
+        "usage: scope_stream [options] [<device or file>]\n"
+        "  -b            Write binary sample_t records (ch1 with the ModeOP bit 15, ch2)\n"
+        "                instead of CSV lines: sample,time_us,ch1,ch2,op\n"
+        "  -o <file>     Output file (default stdout)\n"
+        "The input is stdin when no device or file is given.\n");
+    exit(1);
+}
+
+typedef struct decoder_s
+{
+    FILE    *out;
+    bool     binary;
+    bool     started;
+    uint32_t next;       // Expected seq of the next frame
+    uint64_t time;       // us, time of sample next
+    uint64_t frames;
+    uint64_t samples;
+    uint64_t lost;
+    uint64_t skipped;    // Bytes outside valid frames
+} decoder_t;
+
+static void output(decoder_t *d, const stream_header_t *hdr, const sample_t *samples)
+{
+    if(d->started && (hdr->seq != d->next)) {
+        uint32_t gap = hdr->seq - d->next;
+
+        d->lost += gap;
+        d->time += (uint64_t)gap * hdr->interval;
+    }
+    d->started = true;
+    if(d->binary) {
+        fwrite(samples, sizeof(sample_t), hdr->count, d->out);
+    } else {
+        for(uint32_t i=0; i<hdr->count; i++) {
+            fprintf(d->out, "%lu,%llu,%u,%u,%u\n", (unsigned long)(hdr->seq + i),
+                    (unsigned long long)(d->time + (uint64_t)i * hdr->interval),
+                    samples[i].ch1 & SAMPLE_VALUE, samples[i].ch2 & SAMPLE_VALUE,
+                    (samples[i].ch1 & SAMPLE_TRIGGER) ? 1 : 0);
+        }
+    }
+    d->time += (uint64_t)hdr->count * hdr->interval;
+    d->next = hdr->seq + hdr->count;
+    d->frames++;
+    d->samples += hdr->count;
+}
+
+/*
+ * Decode the frames in buf, returns the number of bytes used
+ */
+static size_t decode(decoder_t *d, const uint8_t *buf, size_t len, bool eof)
+{
+    stream_header_t hdr;
+    sample_t samples[STREAM_SAMPLES];
+    size_t pos = 0;
+
+    while(pos < len) {
+        int n = stream_decode(&buf[pos], len - pos, &hdr, samples);
+
+        if(n > 0) {
+            output(d, &hdr, samples);
+            pos += n;
+        } else if((n < 0) || eof) {
+            d->skipped++;
+            pos++;
+        } else {
+            break; // Wait for the rest of the frame
+        }
+    }
+    return pos;
+}
+
+int main(int argc, char *argv[])
+{
+    decoder_t dec = {};
+    std::vector<uint8_t> buf;
+    uint8_t chunk[16384];
+    int opt, fd = 0;
+
+    dec.out = stdout;
+    while((opt = getopt(argc, argv, "bo:")) != -1) {
+        switch(opt) {
+            case 'b': dec.binary = true; break;
+            case 'o':
+                dec.out = fopen(optarg, "wb");
+                if(!dec.out) {
+                    fprintf(stderr, "Error: cannot open %s\n", optarg);
+                    return 1;
+                }
+                break;
+            default:  usage();
+        }
+    }
+    if(optind < argc - 1) {
+        usage();
+    }
+    if((optind == argc - 1) && strcmp(argv[optind], "-")) {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if(fd < 0) {
+            fprintf(stderr, "Error: cannot open %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+    }
+    if(!dec.binary) {
+        fprintf(dec.out, "sample,time_us,ch1,ch2,op\n");
+    }
+
+    for(;;) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break; // End of file, or EIO when the other side of a pty closes
+        buf.insert(buf.end(), chunk, chunk + n);
+        buf.erase(buf.begin(), buf.begin() + decode(&dec, buf.data(), buf.size(), false));
+    }
+    decode(&dec, buf.data(), buf.size(), true);
+
+    fprintf(stderr, "%llu frames, %llu samples, %llu lost, %llu bytes skipped\n",
+            (unsigned long long)dec.frames, (unsigned long long)dec.samples,
+            (unsigned long long)dec.lost, (unsigned long long)dec.skipped);
+    if(dec.out != stdout) {
+        fclose(dec.out);
+    }
+    return 0;
+}
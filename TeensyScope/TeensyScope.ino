@@ -1,8 +1,19 @@
 #include <ADC.h>
 #include <IntervalTimer.h>
+#include <EEPROM.h>
 
 #include "src/MyLCD/MyLCD.h"
 #include "cli.h"
+#include "phosphor.h"
+#include "sample_ring.h"
+#include "acquisition.h"
+#include "timebase.h"
+#include "column.h"
+#include "trigger.h"
+#include "beam.h"
+#include "calibration.h"
+#include "perf.h"
+#include "stream.h"
 
 #define VERSION "0.2.0"
 
@@ -21,55 +32,232 @@ MyLCD lcd;
 #define YDIV 8
 #define SUBDIV 5
 
+#define FRAME_INTERVAL 10  // Minimum time between the start of two frames in ms
+#define PUSH_LINES     40  // Max. number of lines pushed to the LCD in one loop
+#define PUSH_COLUMNS   40  // Max. number of time mode columns pushed to the LCD in one loop
+
 #define ADC_RESOLUTION    10      // Resolution in bits
+#define SAMPLING_INTERVAL 25      // Default sample interval in microseconds
 
-/*
- * Use hardware oversampling of the ADC.
- * This means that after starting an ADC conversion, the ADC will take
- * the given number of samples and report the average of this as the final result.
- */
-#define ADC_OVERSAMPLING  16      // Hardware oversampling, can be set to 0, 4, 8, 16 or 32
-#define SAMPLING_INTERVAL 25      // microseconds
+#if ADC_RESOLUTION != CALIB_ADC_BITS
+#error "The calibration tables must match the ADC resolution"
+#endif
 
 #define TRIGGER_IN         MODE_OP_PIN
 
 /*
  * Trigger state modes
- *  INIT      - Waiting for the trigger signal to become inactive (HIGH)
- *  WAITING   - Waiting for a fallling edge on the trigger signal
+ *  WAITING   - Waiting for the trigger (see trigger.h)
  *  TRIGGERED - trigger activated the sampling
  *  DONE      - The recording period has finished 
  */
-#define TRIGGER_START       0
 #define TRIGGER_WAITING    1
 #define TRIGGERED          2
 #define TRIGGER_DONE       3
 
+#define AUTO_TIMEOUT       100000  // us, the AUTO trigger fires when there is no edge within this time
+
 ADC *adc = new ADC();
 
-IntervalTimer sampling_timer;
-IntervalTimer decay_timer;
+/*
+ * Samples are passed from the sample interrupt to the rasterizer
+ * in loop() through a lock free ring buffer.
+ */
+#define RASTER_BATCH 256   // Number of samples taken out of the ring at once
+
+sample_ring_t sample_ring;
 
-uint16_t pixel[WIDTH][HEIGHT];
+IntervalTimer optime_timer;
+
+/*
+ * The scope image of the XY display, stored in LCD order (see scope_index() in ScopeRender.h)
+ * so the LCD push and the decay of one line both walk through memory
+ * sequentially. Use PIXEL(x,y) to access a pixel, 0,0 is the bottom left corner.
+ * The time based display does not use the image, it only stores a span per
+ * column for each trace (see scope_trace_t).
+ */
+alignas(16) uint8_t pixel[HEIGHT][WIDTH];
+
+#define PIXEL(x, y) pixel[HEIGHT-1-(y)][WIDTH-1-(x)]
+
+/*
+ * The LCD is updated by the push engine a few lines per loop
+ * so the CLI stays responsive while a frame is being written.
+ */
+LCDPush lcd_push(&lcd);
+reticle_t reticle;
+palette_t palette;
+scope_xy_image_t scope_image = {(uint8_t *)pixel, WIDTH, HEIGHT, &reticle, &palette};
+scope_trace_t trace;
+uint32_t frame_time;
+
+/*
+ * Dirty line tracking for the XY display.
+ * Every line that changes (a pixel is lit or a lit pixel decays) is marked
+ * in dirty_lines so only these lines are pushed to the LCD.
+ * The bitmap is in LCD line order (line 0 is the top line, i.e. y = HEIGHT-1).
+ * frame_lines is the copy that is used by the push engine for the current frame.
+ */
+#define DIRTY_WORDS ((HEIGHT+31)/32)
+
+uint32_t dirty_lines[DIRTY_WORDS];
+uint32_t frame_lines[DIRTY_WORDS];
+
+static inline void mark_dirty_line(uint32_t line)
+{
+    dirty_lines[line >> 5] |= 1UL << (line & 31);
+}
+
+static inline void mark_dirty(uint32_t y)
+{
+    mark_dirty_line(HEIGHT - 1 - y);
+}
+
+void mark_all_dirty()
+{
+    for(int i=0; i<DIRTY_WORDS; i++) dirty_lines[i] = 0xffffffff;
+}
 
 /*
  * Parameters for XY display mode
  */
-uint16_t decay_val = 3;
+uint16_t decay_val = 3;    // Per PHOSPHOR_DECAY_PERIOD (8 ms)
 uint16_t burn_start = 160;
 uint16_t burn_inc = 40;
 uint16_t burn_max = 240;
 
+phosphor_sched_t decay_sched;
+
+beam_t beam;
+bool   beam_lines = true; // Draw the line between two samples
+
+/*
+ * Calibration and scaling of the inputs
+ * The calibration (see calibration.h) is kept in the EEPROM at CALIB_EEPROM_ADDR.
+ * The XY display and the time based display each have their own volts/div
+ * per channel. For every axis a table gives the pixel of each ADC value,
+ * the tables are rebuilt by build_luts() after a change.
+ * The defaults show the nominal 0 - 3.3 V input range over the full XY display
+ * and over 5 divisions of the time based display, with CH2 starting at the 4th division.
+ */
+#define CALIB_EEPROM_ADDR  0
+#define CALIB_SAMPLES      256  // ADC reads averaged for a calibration measurement
+
+calib_t      calib;
+calib_axis_t xy_axis[CALIB_CHANNELS] = {
+    {330000, WIDTH/XDIV, 0, 1, WIDTH-2},   // CH1 is X
+    {412500, HEIGHT/YDIV, 0, 1, HEIGHT-2}  // CH2 is Y
+};
+calib_axis_t time_axis[CALIB_CHANNELS] = {
+    {660000, HEIGHT/YDIV, 0, 1, HEIGHT-3},  // max. is 1 pixel lower, a span is at least 2 pixels
+    {660000, HEIGHT/YDIV, 160, 1, HEIGHT-3}
+};
+uint16_t xy_lut[CALIB_CHANNELS][CALIB_LUT_SIZE];
+uint16_t time_lut[CALIB_CHANNELS][CALIB_LUT_SIZE];
+
 /*
  * Parameters for time based display mode
- * Note that the samples_per_pixel parameters also is used to differentiate between
- * XY and time based mode. With samples_per_pixel set to 0, the scope uses XY display mode
+ * With time_mode set to false, the scope uses XY display mode
+ */
+
+bool       time_mode = false;
+timebase_t timebase;
+uint32_t   x_counter;
+uint8_t    trigger_state;
+trigger_t  trig;
+column_hist_t history;  // Columns before the trigger
+
+/*
+ * The sweep is pushed to the LCD while it is being recorded.
+ * Every loop display() writes the columns that have been finished since
+ * the previous loop. The previous sweep stays visible and is erased
+ * ERASE_AHEAD columns ahead of the write position, like on a real scope.
+ */
+#define ERASE_AHEAD 8
+
+uint32_t   erase_pos;     // Next column to erase
+uint32_t   shown_x;       // Next finished column to push
+uint32_t   shown_erase;   // Next erased column to push
+uint32_t   xy_interval = SAMPLING_INTERVAL; // Sample interval for XY mode, see cmd_rate
+uint8_t    acquire_mode = ACQUIRE_PEAK;
+column_t   column_ch1;
+column_t   column_ch2;
+
+/*
+ * Roll mode
+ * At slow time bases the trace rolls from right to left instead of
+ * being drawn in sweeps. Every finished column is written on its own at
+ * the next position of the LCD memory and the hardware scroll of the LCD
+ * moves it to the right edge of the scope area.
+ * The reticle is part of the LCD memory so it rolls along with the trace.
+ */
+#define ROLL_MIN_DIV 50000  // us/div, faster time bases always use sweeps
+
+bool     roll_mode = false; // Roll mode selected with the roll command
+bool     rolling = false;   // Roll mode is active
+uint32_t roll_pos;          // Next column to record
+uint32_t roll_shown;        // Next column to write to the LCD
+
+/*
+ * Binary sample stream, see stream.h
+ * The rasterizer adds the samples it takes out of the sample ring,
+ * loop() sends the frames when the USB serial port has room for them.
+ */
+stream_t stream;
+uint32_t stream_overruns; // Sample ring overruns already counted as lost
+
+/*
+ * CPU load
+ * The time spent in the rasterizer and in display() is measured with the
+ * cycle counter every loop and summed over LOAD_WINDOW ms. At the end of a
+ * window it gives the rasterizer time per sample and the part of the CPU
+ * time used for the display. cmd_rate uses these to refuse sample intervals
+ * that cannot be kept up with.
+ */
+#define LOAD_WINDOW 1000  // ms
+
+typedef struct load_s
+{
+    uint32_t start;           // millis() at the start of the window
+    uint64_t raster_cycles;   // Cycles in loops that plotted samples
+    uint32_t raster_samples;
+    uint64_t display_cycles;
+    uint32_t raster_ns;       // Results of the last window, ns per sample
+    uint32_t display_pct;     // % of the CPU time
+} load_t;
+
+load_t load;
+
+void load_update()
+{
+    uint32_t elapsed = millis() - load.start;
+
+    if(elapsed < LOAD_WINDOW) {
+        return;
+    }
+    if(load.raster_samples) {
+        load.raster_ns = load.raster_cycles * 1000 / (F_CPU_ACTUAL / 1000000) / load.raster_samples;
+    }
+    load.display_pct = load.display_cycles * 100 / ((uint64_t)elapsed * (F_CPU_ACTUAL / 1000));
+    load.start += elapsed;
+    load.raster_cycles = 0;
+    load.raster_samples = 0;
+    load.display_cycles = 0;
+}
+
+/*
+ * Interrupt time per sample of the current acquisition in ns
  */
+uint32_t isr_ns_per_sample()
+{
+    acq_timing_t t;
 
- uint32_t samples_per_pixel = 0;
- uint32_t sample_counter;
- uint32_t x_counter;
- uint8_t  trigger_state;
+    acq_timing(&t);
+    if(!t.samples) {
+        return 0;
+    }
+    return t.busy * 1000 / (F_CPU_ACTUAL / 1000000) / t.samples;
+}
 
 /*
  * CLI command functions
@@ -97,12 +285,268 @@ void cmd_burn(int num_params, char *param[])
     burn_start = atoi(param[0]);
     burn_inc   = atoi(param[1]);
     burn_max   = atoi(param[2]);
+    if(burn_max > 255) {
+        burn_max = 255;
+        Serial.println("Max. intensity limited to 255, use persist for a longer afterglow");
+    }
+    beam_burn(&beam, burn_start, burn_inc, burn_max);
+}
+
+/*
+ * BEAM command function
+ *
+ * Switch the beam interpolation of the XY display on or off.
+ * "beam bench" measures the time needed to draw segments of different
+ * lengths. The XY display is cleared afterwards.
+ */
+void cmd_beam(int num_params, char *param[])
+{
+    if((num_params == 1) && (strcmp(param[0], "on") == 0)) {
+        beam_lines = true;
+    } else if((num_params == 1) && (strcmp(param[0], "off") == 0)) {
+        beam_lines = false;
+    } else if((num_params == 1) && (strcmp(param[0], "bench") == 0)) {
+        static const int lengths[] = {0, 1, 4, 16, 64, 128, 256};
+        const int count = 1000;
+
+        acq_stop();
+        lcd_push.abort();
+        for(unsigned l=0; l<sizeof(lengths)/sizeof(lengths[0]); l++) {
+            uint32_t cycles;
+
+            beam_off(&beam);
+            beam_move(&beam, 20, 20);
+            cycles = ARM_DWT_CYCCNT;
+            for(int i=0; i<count; i++) {
+                // Back and forth along a diagonal
+                int x = 20 + ((i & 1) ? 0 : lengths[l]);
+                beam_move(&beam, x, 20 + ((i & 1) ? 0 : lengths[l] / 2));
+            }
+            cycles = ARM_DWT_CYCCNT - cycles;
+            Serial.printf("segment %3d px: %5d cycles, %6.2f us\n", lengths[l],
+                          cycles / count, (float)cycles / count / (F_CPU_ACTUAL / 1000000));
+        }
+        memset(pixel, 0, sizeof(pixel));
+        mark_all_dirty();
+        beam_off(&beam);
+        sample_ring_reset(&sample_ring);
+        acq_start(time_mode ? timebase.interval : xy_interval);
+    } else {
+        Serial.println("Error: usage is beam <on|off|bench>");
+    }
+}
+
+/*
+ * PALETTE and PERSIST command functions
+ *
+ * Select the colors of the XY display and how long a pixel stays
+ * at full brightness before it visibly fades (the top 'persist'
+ * intensity levels are all shown at full brightness).
+ */
+void cmd_palette(int num_params, char *param[])
+{
+    uint8_t style;
+
+    if(num_params == 1) {
+        for(style=0; style<PALETTE_STYLES; style++) {
+            if(strcmp(param[0], palette_name(style)) == 0) {
+                palette_build(&palette, style, palette.persist);
+                mark_all_dirty();
+                return;
+            }
+        }
+    }
+    Serial.println("Error: usage is palette <classic|p31|p7|amber|heat>");
+}
+
+void cmd_persist(int num_params, char *param[])
+{
+    int persist;
+
+    if(num_params != 1) {
+        Serial.println("Error: usage is persist <0..240>");
+        return;
+    }
+    persist = atoi(param[0]);
+    if((persist < 0) || (persist > PALETTE_MAX_PERSIST)) {
+        Serial.println("Error: usage is persist <0..240>");
+        return;
+    }
+    palette_build(&palette, palette.style, persist);
+    mark_all_dirty();
+}
+
+/*
+ * Rebuild the ADC value to pixel tables of all axes.
+ * The tables are only used by the rasterizer in loop() and the CLI commands
+ * also run from loop(), so a sample is never plotted with a half built table.
+ */
+void build_luts()
+{
+    for(int i=0; i<CALIB_CHANNELS; i++) {
+        calib_build(xy_lut[i], &calib.ch[i], &xy_axis[i]);
+        calib_build(time_lut[i], &calib.ch[i], &time_axis[i]);
+    }
+}
+
+/*
+ * Channel number of a "ch1" or "ch2" parameter, -1 when it is not a channel
+ */
+int parse_channel(const char *param)
+{
+    if(strcmp(param, "ch1") == 0) return 0;
+    if(strcmp(param, "ch2") == 0) return 1;
+    return -1;
+}
+
+/*
+ * Average ADC value of a channel, used to calibrate with a known input voltage.
+ * Sampling is stopped during the measurement.
+ */
+uint32_t measure_input(int ch)
+{
+    uint32_t sum = 0;
+
+    acq_stop();
+    for(int i=0; i<CALIB_SAMPLES; i++) {
+        sum += (ch == 0) ? adc->adc0->analogRead(14) : adc->adc1->analogRead(15);
+    }
+    sample_ring_reset(&sample_ring);
+    acq_start(acq_interval());
+    return (sum + CALIB_SAMPLES/2) / CALIB_SAMPLES;
+}
+
+/*
+ * VDIV command function
+ *
+ * Set the volts per division of a channel for the current display mode,
+ * e.g. vdiv ch1 0.5 or vdiv ch2 200mv. Without parameters the settings are shown.
+ */
+void cmd_vdiv(int num_params, char *param[])
+{
+    calib_axis_t *axis = time_mode ? time_axis : xy_axis;
+    char text[16];
+    int ch;
+
+    if(num_params == 2) {
+        uint32_t uv = calib_parse_volts(param[1]);
+
+        ch = parse_channel(param[0]);
+        if((ch < 0) || (uv == 0)) {
+            Serial.println("Error: usage is vdiv [ch1|ch2 <volts/div>]");
+            return;
+        }
+        axis[ch].uv_div = uv;
+        build_luts();
+    } else if(num_params != 0) {
+        Serial.println("Error: usage is vdiv [ch1|ch2 <volts/div>]");
+        return;
+    }
+    for(ch=0; ch<CALIB_CHANNELS; ch++) {
+        calib_format_volts(axis[ch].uv_div, text, sizeof(text));
+        Serial.printf("CH%d: %s/div\n", ch+1, text);
+    }
+}
+
+/*
+ * CAL command function
+ *
+ * Calibrate the offset and gain of the channels:
+ *   cal ch1 zero           - Measure the offset, the input must be at 0 V
+ *   cal ch1 ref <volts>    - Measure the gain, the input must be at the given voltage
+ *   cal ch1 offset <val>   - Set the offset (ADC value at 0 V)
+ *   cal ch1 gain <factor>  - Set the gain correction
+ *   cal save|load|reset    - Save to or load from the EEPROM, or use the nominal values
+ * Without parameters the calibration is shown.
+ */
+void cmd_cal(int num_params, char *param[])
+{
+    int ch = (num_params >= 2) ? parse_channel(param[0]) : -1;
+
+    if((num_params == 1) && (strcmp(param[0], "save") == 0)) {
+        EEPROM.put(CALIB_EEPROM_ADDR, calib);
+        Serial.println("Calibration saved");
+    } else if((num_params == 1) && (strcmp(param[0], "load") == 0)) {
+        EEPROM.get(CALIB_EEPROM_ADDR, calib);
+        if(!calib_valid(&calib)) {
+            Serial.println("No valid calibration in the EEPROM, using nominal values");
+            calib_init(&calib);
+        }
+    } else if((num_params == 1) && (strcmp(param[0], "reset") == 0)) {
+        calib_init(&calib);
+    } else if((ch >= 0) && (num_params == 2) && (strcmp(param[1], "zero") == 0)) {
+        calib.ch[ch].offset = measure_input(ch);
+    } else if((ch >= 0) && (num_params == 3) && (strcmp(param[1], "ref") == 0)) {
+        int32_t counts = measure_input(ch) - calib.ch[ch].offset;
+        uint32_t uv = calib_parse_volts(param[2]);
+        float gain;
+
+        if((counts <= 0) || (uv == 0)) {
+            Serial.println("Error: the input must be above the 0 V level");
+            return;
+        }
+        gain = (float)uv / ((float)counts * CALIB_FULL_SCALE / CALIB_LUT_SIZE);
+        if((gain < CALIB_MIN_GAIN) || (gain > CALIB_MAX_GAIN)) {
+            Serial.printf("Error: gain %1.4f is out of range, check the input voltage\n", gain);
+            return;
+        }
+        calib.ch[ch].gain = gain;
+    } else if((ch >= 0) && (num_params == 3) && (strcmp(param[1], "offset") == 0)) {
+        int offset = atoi(param[2]);
+
+        if((offset < 0) || (offset >= CALIB_LUT_SIZE)) {
+            Serial.printf("Error: offset must be between 0 and %d\n", CALIB_LUT_SIZE-1);
+            return;
+        }
+        calib.ch[ch].offset = offset;
+    } else if((ch >= 0) && (num_params == 3) && (strcmp(param[1], "gain") == 0)) {
+        float gain = atof(param[2]);
+
+        if((gain < CALIB_MIN_GAIN) || (gain > CALIB_MAX_GAIN)) {
+            Serial.printf("Error: gain must be between %1.1f and %1.1f\n", CALIB_MIN_GAIN, CALIB_MAX_GAIN);
+            return;
+        }
+        calib.ch[ch].gain = gain;
+    } else if(num_params != 0) {
+        Serial.println("Error: usage is cal [ch1|ch2 zero|ref <volts>|offset <val>|gain <factor>] [save|load|reset]");
+        return;
+    }
+    build_luts();
+    for(ch=0; ch<CALIB_CHANNELS; ch++) {
+        Serial.printf("CH%d: offset %d, gain %1.4f\n", ch+1, calib.ch[ch].offset, calib.ch[ch].gain);
+    }
 }
 
 void cmd_status(int num_params, char *parm[])
 {
     Serial.printf("decay_val %d\n", decay_val);
-    Serial.printf("burn %d %d %d\n\n", burn_start, burn_inc, burn_max);
+    Serial.printf("burn %d %d %d\n", burn_start, burn_inc, burn_max);
+    Serial.printf("palette %s, persist %d\n", palette_name(palette.style), palette.persist);
+    Serial.printf("sampling every %d us (%s)\n", acq_interval(), acq_dma_active() ? "DMA" : "timer");
+    if(time_mode) {
+        char text[16];
+
+        timebase_format(timebase.us_div, text, sizeof(text));
+        Serial.printf("time base %s/div%s\n", text, rolling ? ", rolling" : "");
+    }
+    Serial.printf("sample ring: %d overruns, max. fill %d of %d\n",
+                  sample_ring.overruns.load(), sample_ring.max_fill, SAMPLE_RING_SIZE);
+
+    acq_timing_t t;
+    uint32_t cycles_us = F_CPU_ACTUAL / 1000000;
+
+    acq_timing(&t);
+    Serial.printf("timing: %lu samples, %lu late, %lu missed, %lu DMA overruns, max. deviation %1.2f us\n",
+                  (unsigned long)t.samples, (unsigned long)t.late, (unsigned long)t.missed,
+                  (unsigned long)t.overruns, (float)t.max_dev / cycles_us);
+    Serial.print("deviation <cycles:");
+    for(int i=0; i<ACQ_JITTER_BUCKETS; i++) {
+        if(t.hist[i]) Serial.printf(" %lu:%lu", 2UL << i, (unsigned long)t.hist[i]);
+    }
+    Serial.println();
+    Serial.printf("load: interrupt %lu ns, rasterizer %lu ns per sample, display %lu%%\n\n",
+                  (unsigned long)isr_ns_per_sample(), (unsigned long)load.raster_ns,
+                  (unsigned long)load.display_pct);
 }
 
 uint32_t op_time;
@@ -161,12 +605,12 @@ void cmd_optime(int num_params, char *param[])
 
     // Stop sampling the ADC and initialize measurement
 
-    sampling_timer.end(); // Stop sampling the analog signals
+    acq_stop(); // Stop sampling the analog signals
     Serial.println("Starting OP-time measurement");
 
     sample_op_state = 0;
     time = millis();
-    sampling_timer.begin(sample_optime, SAMPLING_INTERVAL);
+    optime_timer.begin(sample_optime, SAMPLING_INTERVAL);
 
     // Wait for the measurement to complete or for a timeout
     while(millis() < (time + 25000)) {
@@ -177,7 +621,7 @@ void cmd_optime(int num_params, char *param[])
 
     // Stop the measurement and display the result
 
-    sampling_timer.end();
+    optime_timer.end();
 
     if(sample_op_state == 3) {
         Serial.printf("OP-time = %1.2f ms\n", op_time * SAMPLING_INTERVAL / 1000.0);
@@ -188,8 +632,70 @@ void cmd_optime(int num_params, char *param[])
     }
 
     // Restart regular sampling function
-    adc->startSynchronizedSingleRead(0, 1); // start ADC, read A0 and A1 channels
-    sampling_timer.begin(sample, 25); // Start sampling at 25 us interval
+    sample_ring_reset(&sample_ring);
+    acq_start(acq_interval());
+}
+
+/*
+ * Start roll mode: clear the scope area and make it the scroll area of the LCD
+ */
+void start_roll()
+{
+    lcd_push.abort();
+    scope_trace_clear(&trace);
+    lcd.draw_scope(0, 0, &trace);
+    lcd.scroll_area(0, WIDTH);
+    timebase_restart(&timebase);
+    column_start(&column_ch1);
+    column_start(&column_ch2);
+    roll_pos = 0;
+    roll_shown = 0;
+    rolling = true;
+}
+
+/*
+ * Number of pre-trigger columns
+ */
+uint32_t pre_columns()
+{
+    return WIDTH * trig.pre / 100;
+}
+
+/*
+ * Arm the trigger for the next sweep.
+ * The hold off is the number of samples needed to fill the pre-trigger columns.
+ */
+void arm_trigger()
+{
+    uint64_t holdoff = ((uint64_t)pre_columns() * timebase.us_div + timebase.step - 1) / timebase.step;
+
+    trigger_arm(&trig, holdoff, AUTO_TIMEOUT / timebase.interval);
+}
+
+/*
+ * Start a new sweep of the time based display.
+ * The trace of the previous sweep is kept until it is erased.
+ */
+void restart_sweep()
+{
+    timebase_restart(&timebase);
+    column_start(&column_ch1);
+    column_start(&column_ch2);
+    x_counter = 0;
+    erase_pos = 0;
+    shown_x = 0;
+    shown_erase = 0;
+    history.head = 0;
+    trigger_state = TRIGGER_WAITING;
+    arm_trigger();
+}
+
+void stop_roll()
+{
+    if(rolling) {
+        lcd.scroll_off();
+        rolling = false;
+    }
 }
 
 /*
@@ -198,47 +704,312 @@ void cmd_optime(int num_params, char *param[])
  * The time command initialized the time base scope display.
  * If the display was already in timing mode, the previous timing will be replaced.
  * If the display was in XY mode, the display will switch from XY to timing mode.
+ *
+ * The time per division can be given with a unit (us, ms or s), without a unit
+ * it is in ms. "time +" and "time -" step to the next or previous 1-2-5 setting.
  */
 
 void cmd_time(int num_params, char *param[])
 {
     uint32_t usec;
+    char     text[16];
 
     if(num_params != 1) {
-        Serial.println("Error: usage is time <msec/div>");
+        Serial.println("Error: usage is time <time/div|+|->");
         return;
     }
 
-    sampling_timer.end(); // Stop sampling while reconfiguring
+    if((strcmp(param[0], "+") == 0) || (strcmp(param[0], "-") == 0)) {
+        usec = timebase_next(time_mode ? timebase.us_div : 1000, (param[0][0] == '+') ? 1 : -1);
+    } else {
+        usec = timebase_parse(param[0]);
+    }
+    if((usec < TIMEBASE_MIN_DIV) || (usec > TIMEBASE_MAX_DIV)) {
+        Serial.println("Error: time/div must be between 10us and 5s");
+        return;
+    }
+
+    acq_stop(); // Stop sampling while reconfiguring
+    lcd_push.abort();
+
     /*
-     * Calculate how many samples we collect per vertical line of pixels on the LCD.
-     * With a width of 400 pixels we have 40 pixels/div so the default 25 us/sample
-     * results in 25 * 40 = 1000 us per division so we can calculate the number
-     * of samples per line using a simple division.
+     * The time base selects the sample interval and how far
+     * each sample moves the trace (40 pixels/div).
      */
-    usec = atoi(param[0]) * 1000;
-    samples_per_pixel = usec / SAMPLING_INTERVAL / (WIDTH/10);
-    //samples_per_pixel = usec / 10 / (WIDTH/10);
-    sample_counter = 0;
-    x_counter = 0;
-    trigger_state = TRIGGER_START;
+    timebase_set(&timebase, usec, WIDTH/XDIV);
+    time_mode = true;
+    restart_sweep();
+    sample_ring_reset(&sample_ring);
 
-    Serial.printf("Timing set to %d samples/pixel\n", samples_per_pixel);
+    timebase_format(usec, text, sizeof(text));
+    Serial.printf("Timing set to %s/div, sampling every %d us, %1.2f samples/pixel\n",
+                  text, timebase.interval, (float)timebase.us_div / timebase.step);
 
-    memset(pixel, 0, sizeof(pixel)); // clear display
+    scope_trace_clear(&trace); // clear display
+    if(roll_mode && (usec >= ROLL_MIN_DIV)) {
+        start_roll();
+    } else {
+        stop_roll();
+        lcd.draw_scope(0, 0, &trace);
+    }
 
-    sampling_timer.begin(sample, SAMPLING_INTERVAL); // Restart sampling
-    //sampling_timer.begin(sample, 10); // Restart sampling
+    acq_start(timebase.interval); // Restart sampling
 }
 
 void cmd_xy(int num_params, char *param[])
 {
-    sampling_timer.end();
-    samples_per_pixel = 0;
+    acq_stop();
+    lcd_push.abort();
+    stop_roll();
+    time_mode = false;
+    beam_off(&beam);
     memset(pixel, 0, sizeof(pixel));
-    sampling_timer.begin(sample, SAMPLING_INTERVAL);
+    mark_all_dirty();
+    sample_ring_reset(&sample_ring);
+    acq_start(xy_interval);
 }
 
+/*
+ * RATE command function
+ *
+ * Set the sample interval in us for the XY display. Intervals below ACQ_TIMER_MIN_INTERVAL
+ * use the DMA acquisition, the ADC averaging is reduced to fit the interval unless
+ * it is given. In XY mode a setting that cannot be met with the measured interrupt,
+ * rasterizer and display times is refused (see acq_check()).
+ * In time mode the sample interval is selected by the time base.
+ */
+void cmd_rate(int num_params, char *param[])
+{
+    uint32_t interval;
+    uint8_t avg = ACQ_AUTO_AVERAGING;
+    const char *err;
+
+    if((num_params < 1) || (num_params > 2)) {
+        Serial.println("Error: usage is rate <usec> [0|4|8|16|32|auto]");
+        return;
+    }
+    interval = atoi(param[0]);
+    if((interval < ACQ_MIN_INTERVAL) || (interval > ACQ_MAX_INTERVAL)) {
+        Serial.printf("Error: rate must be between %d and %d us\n", ACQ_MIN_INTERVAL, ACQ_MAX_INTERVAL);
+        return;
+    }
+    if((num_params == 2) && strcmp(param[1], "auto")) {
+        int val = atoi(param[1]);
+
+        if((val != 0) && (val != 4) && (val != 8) && (val != 16) && (val != 32)) {
+            Serial.println("Error: averaging must be 0, 4, 8, 16, 32 or auto");
+            return;
+        }
+        avg = val;
+    }
+    if(!time_mode) {
+        err = acq_check(interval, avg, isr_ns_per_sample(), load.raster_ns, load.display_pct);
+        if(err) {
+            Serial.printf("Error: %s\n", err);
+            return;
+        }
+    }
+    xy_interval = interval;
+    acq_set_averaging(avg);
+    if(time_mode) {
+        Serial.println("Time mode, the sample interval is set by the time base");
+        return;
+    }
+    acq_stop();
+    sample_ring_reset(&sample_ring);
+    acq_start(interval);
+    Serial.printf("Sampling every %d us (%s, averaging %d)\n", interval,
+                  acq_dma_active() ? "DMA" : "timer", acq_averaging(interval));
+}
+
+
+/*
+ * ACQUIRE command function
+ *
+ * Select what is shown for a column of the time based display when
+ * more than one sample goes into a column.
+ */
+void cmd_acquire(int num_params, char *param[])
+{
+    if(num_params != 1) {
+        Serial.println("Error: usage is acquire <sample|peak|average>");
+        return;
+    }
+    if(strcmp(param[0], "sample") == 0) {
+        acquire_mode = ACQUIRE_SAMPLE;
+    } else if(strcmp(param[0], "peak") == 0) {
+        acquire_mode = ACQUIRE_PEAK;
+    } else if(strcmp(param[0], "average") == 0) {
+        acquire_mode = ACQUIRE_AVERAGE;
+    } else {
+        Serial.println("Error: usage is acquire <sample|peak|average>");
+        return;
+    }
+}
+
+/*
+ * ROLL command function
+ *
+ * With roll mode on, time bases of 50 ms/div and slower show a rolling
+ * trace that is updated for every column instead of waiting for a full sweep.
+ */
+void cmd_roll(int num_params, char *param[])
+{
+    if((num_params == 1) && (strcmp(param[0], "on") == 0)) {
+        roll_mode = true;
+        if(time_mode && (timebase.us_div >= ROLL_MIN_DIV) && !rolling) {
+            acq_stop();
+            sample_ring_reset(&sample_ring);
+            start_roll();
+            acq_start(timebase.interval);
+        }
+    } else if((num_params == 1) && (strcmp(param[0], "off") == 0)) {
+        roll_mode = false;
+        if(rolling) {
+            acq_stop();
+            stop_roll();
+            scope_trace_clear(&trace);
+            lcd.draw_scope(0, 0, &trace);
+            restart_sweep();
+            sample_ring_reset(&sample_ring);
+            acq_start(timebase.interval);
+        }
+    } else {
+        Serial.println("Error: usage is roll <on|off>");
+    }
+}
+
+/*
+ * TRIGGER command function
+ *
+ * Set up the trigger of the time based display. Any combination of these can be given:
+ *   ch1 | ch2 | ext              - Source, ext is the ModeOP input
+ *   rising | falling | either    - Slope
+ *   auto | normal | single       - Mode, single also arms the trigger again
+ *   level <val> [<hysteresis>]   - Level in ADC counts
+ *   pre <percent>                - Part of the sweep shown before the trigger
+ * Without parameters the current settings are shown.
+ */
+void cmd_trigger(int num_params, char *param[])
+{
+    static const char *sources[] = {"ch1", "ch2", "ext"};
+    static const char *slopes[] = {"", "rising", "falling", "either"};
+    static const char *modes[] = {"auto", "normal", "single"};
+
+    for(int i=0; i<num_params; i++) {
+        if(strcmp(param[i], "ch1") == 0) {
+            trig.source = TRIGGER_SRC_CH1;
+        } else if(strcmp(param[i], "ch2") == 0) {
+            trig.source = TRIGGER_SRC_CH2;
+        } else if(strcmp(param[i], "ext") == 0) {
+            trig.source = TRIGGER_SRC_EXT;
+        } else if(strcmp(param[i], "rising") == 0) {
+            trig.slope = TRIGGER_RISING;
+        } else if(strcmp(param[i], "falling") == 0) {
+            trig.slope = TRIGGER_FALLING;
+        } else if(strcmp(param[i], "either") == 0) {
+            trig.slope = TRIGGER_EITHER;
+        } else if(strcmp(param[i], "auto") == 0) {
+            trig.mode = TRIGGER_AUTO;
+        } else if(strcmp(param[i], "normal") == 0) {
+            trig.mode = TRIGGER_NORMAL;
+        } else if(strcmp(param[i], "single") == 0) {
+            trig.mode = TRIGGER_SINGLE;
+            trigger_rearm(&trig);
+        } else if((strcmp(param[i], "level") == 0) && (i+1 < num_params)) {
+            trig.level = atoi(param[++i]);
+            if((i+1 < num_params) && isdigit(param[i+1][0])) {
+                trig.hysteresis = atoi(param[++i]);
+            }
+        } else if((strcmp(param[i], "pre") == 0) && (i+1 < num_params)) {
+            int pre = atoi(param[++i]);
+            trig.pre = (pre < 0) ? 0 : ((pre > TRIGGER_MAX_PRE) ? TRIGGER_MAX_PRE : pre);
+        } else {
+            Serial.println("Error: usage is trigger [ch1|ch2|ext] [rising|falling|either] [auto|normal|single]");
+            Serial.println("                       [level <val> [<hysteresis>]] [pre <percent>]");
+            return;
+        }
+    }
+    trigger_update(&trig);
+    if(time_mode && (trigger_state == TRIGGER_WAITING)) {
+        arm_trigger();
+    }
+    Serial.printf("Trigger: %s %s %s, level %d hysteresis %d, pre-trigger %d%%\n",
+                  sources[trig.source], slopes[trig.slope], modes[trig.mode],
+                  trig.level, trig.hysteresis, trig.pre);
+}
+
+/*
+ * GRID command function
+ *
+ * Select the reticle style. The reticle is only rebuilt here
+ * so changing the style costs nothing while drawing frames.
+ */
+void cmd_grid(int num_params, char *param[])
+{
+    uint8_t style;
+
+    if(num_params != 1) {
+        Serial.println("Error: usage is grid <off|full|cross>");
+        return;
+    }
+    if(strcmp(param[0], "off") == 0) {
+        style = RETICLE_OFF;
+    } else if(strcmp(param[0], "full") == 0) {
+        style = RETICLE_FULL;
+    } else if(strcmp(param[0], "cross") == 0) {
+        style = RETICLE_CROSS;
+    } else {
+        Serial.println("Error: usage is grid <off|full|cross>");
+        return;
+    }
+    reticle_build(&reticle, WIDTH, HEIGHT, XDIV, YDIV, SUBDIV, style);
+    mark_all_dirty(); // The reticle is only visible on lines that are pushed
+}
+
+/*
+ * PERF command function
+ *
+ * Print the cycle counts of the profiled sections (see perf.h),
+ * "perf reset" clears them.
+ */
+void cmd_perf(int num_params, char *param[])
+{
+    if((num_params == 1) && (strcmp(param[0], "reset") == 0)) {
+        perf_reset();
+    } else if(num_params == 0) {
+        perf_print();
+    } else {
+        Serial.println("Error: usage is perf [reset]");
+    }
+}
+
+/*
+ * STREAM command function
+ *
+ * Start or stop the binary sample stream, without parameters show its statistics.
+ */
+void cmd_stream(int num_params, char *param[])
+{
+    if(num_params == 0) {
+        Serial.printf("stream %s, %lu frames sent, %lu queued, %lu samples, %lu lost\n",
+                      stream.on ? "on" : "off", (unsigned long)stream.frames,
+                      (unsigned long)(stream.head - stream.tail), (unsigned long)stream.seq,
+                      (unsigned long)stream.lost);
+        return;
+    }
+    if(!strcmp(param[0], "on")) {
+        if(!stream.on) {
+            stream_init(&stream, ADC_RESOLUTION);
+            stream_overruns = sample_ring.overruns.load();
+            stream_start(&stream, acq_interval());
+        }
+    } else if(!strcmp(param[0], "off")) {
+        stream_stop(&stream);
+    } else {
+        Serial.println("Error: usage is stream [on|off]");
+    }
+}
 
 void cmd_reset(int num_params, char *param[])
 {
@@ -251,200 +1022,415 @@ void cmd_help(int num_params, char *param[])
     Serial.print("TeensyScope, version: ");
     Serial.println(VERSION);
     Serial.println();
-    Serial.println("decay <val>              - Set the decay value at which the 'phosphor' will fade out");
+    Serial.println("decay <val>              - Set the decay value (per 8 ms) at which the 'phosphor' will fade out");
     Serial.println("burn <start> <inc> <max> - Set the values for the burn-in of the 'phosphor'");
+    Serial.println("beam <on|off|bench>      - Draw lines between the XY samples, bench measures the cost");
     Serial.println("status                   - Print the current burn and decay values");
     Serial.println("optime                   - Measure the current OP-time in msec");
-    Serial.println("time <msec>              - Set the scope in time based mode with msec/div");
+    Serial.println("time <time/div|+|->      - Set the scope in time based mode, e.g. time 2.5ms or time 100us");
     Serial.println("xy                       - Set the scope in XY display mode");
+    Serial.println("rate <usec> [<avg>|auto] - Set the XY mode sample interval (1 - 1000 us) and ADC averaging");
+    Serial.println("acquire <sample|peak|average> - Select how a time mode column shows its samples");
+    Serial.println("roll <on|off>            - Roll the trace at time bases of 50 ms/div and slower");
+    Serial.println("trigger [ch1|ch2|ext] [rising|falling|either] [auto|normal|single] [level <val> [<hyst>]] [pre <%>]");
+    Serial.println("                         - Set up the trigger of the time based display");
+    Serial.println("grid <off|full|cross>    - Select the reticle style");
+    Serial.println("vdiv [ch1|ch2 <volts/div>] - Set the volts/div of a channel for the current display mode");
+    Serial.println("cal [ch1|ch2 zero|ref <volts>|offset <val>|gain <factor>] [save|load|reset]");
+    Serial.println("                         - Calibrate the inputs, save stores the calibration in the EEPROM");
+    Serial.println("palette <classic|p31|p7|amber|heat> - Select the colors of the XY display");
+    Serial.println("persist <0..240>         - Number of top intensity levels shown at full brightness");
+    Serial.println("perf [reset]             - Show the cycle counts of the profiled sections or clear them");
+    Serial.println("stream [on|off]          - Send the samples as binary frames over USB, see stream.h");
     Serial.println("reset                    - Reset the Teensy, start over");
 }
 
 cli_command_t cli_commands[] = {
     {"decay", cmd_decay},
     {"burn", cmd_burn},
+    {"beam", cmd_beam},
     {"status", cmd_status},
     {"optime", cmd_optime},
     {"time", cmd_time},
     {"xy", cmd_xy},
+    {"rate", cmd_rate},
+    {"acquire", cmd_acquire},
+    {"roll", cmd_roll},
+    {"trigger", cmd_trigger},
+    {"grid", cmd_grid},
+    {"vdiv", cmd_vdiv},
+    {"cal", cmd_cal},
+    {"palette", cmd_palette},
+    {"persist", cmd_persist},
+    {"perf", cmd_perf},
+    {"stream", cmd_stream},
     {"reset", cmd_reset},
     {"?", cmd_help},
     {"\0", NULL}
 };
 
-int cnt=0; // Used to keep track of the display line number in the decay part of the interrupt
+/*
+ * Plot a sample on the XY display
+ */
+void plot_xy(uint32_t x, uint32_t y)
+{
+    /*
+     * Scale the ADC values with the calibration and the volts/div of the
+     * X and Y axis (see build_luts()). The tables also clip the position
+     * to the display area, leaving the border free to keep the white
+     * border around the image.
+     */
+    x = calib_pixel(xy_lut[0], x);
+    y = calib_pixel(xy_lut[1], y);
 
-void sample() {
-    uint32_t x,y;
-    
-    digitalWriteFast(11,1); // Use pin 11 to measure the time spent in the interrupt
+    /*
+     * We now have a valid X,Y position inside the XY display image.
+     * The PIXEL(x, y) matrix contains the brightness for each pixel
+     * To mimic the analog phosphor style CRT display, 4 parameters are
+     * being used:
+     * - burn_start is the initial intensity of the pixel as soon the 'beam' hits the screen
+     * - burn_inc   determines how fast the intensity of a pixel increases
+     *              (a slow moving beam results in more light being emited by the phosphor
+     * - burn_max   is the maximum intensity of the 'phosphor' (at most 255)
+     *              This is being used to prevent a "burn in" situation where a pixel
+     *              is never extinguished.
+     *              A longer afterglow is set with the persistence of the palette.
+     *              When the maximum intensity has been reached, pixels around the current pixel
+     *              will also be lit to increase the size of the dot/line in a similar way as 
+     *              on a CRT.
+     * - decay_val  Is the speed at which a pixel will extinguish again.
+     *              This is done in decay() from the main loop and is based on the
+     *              elapsed time so it does not depend on the sample rate.
+     * With beam interpolation on, the line from the previous sample is drawn
+     * with an intensity that goes down with the length of the line (see beam.h).
+     * The dot only grows when the beam does not move.
+     */
+    if(!beam_lines) {
+        beam_off(&beam); // Only plot the sample itself
+    }
+    beam_move(&beam, x, y);
+}
+
+/*
+ * Set the span of a trace in a column of the time based display.
+ * The ADC values are scaled and clipped with the table of the channel (see build_luts()).
+ * A span is at least 2 pixels high to keep a flat trace visible.
+ */
+void draw_span(uint32_t x, int t, uint16_t lo, uint16_t hi)
+{
+    uint32_t y0 = calib_pixel(time_lut[t], lo);
+    uint32_t y1 = calib_pixel(time_lut[t], hi) + 1;
+
+    scope_trace_set(&trace, t, x, y0, y1);
+}
+
+/*
+ * Draw the collected samples of a column of the time based display
+ */
+void draw_column(uint32_t x)
+{
+    uint16_t lo, hi;
+
+    if(column_span(&column_ch1, acquire_mode, &lo, &hi)) {
+        draw_span(x, 0, lo, hi);
+    }
+    if(column_span(&column_ch2, acquire_mode, &lo, &hi)) {
+        draw_span(x, 1, lo, hi);
+    }
+    column_start(&column_ch1);
+    column_start(&column_ch2);
+}
+
+/*
+ * Erase the previous sweep up to ERASE_AHEAD columns ahead of the write position
+ */
+void erase_ahead()
+{
+    uint32_t end = x_counter + ERASE_AHEAD;
+
+    if(end > WIDTH) end = WIDTH;
+    while(erase_pos < end) {
+        scope_trace_clear_column(&trace, erase_pos++);
+    }
+}
+
+/*
+ * The trigger has fired, start the sweep with the pre-trigger columns
+ */
+void start_trace()
+{
+    uint32_t pre = pre_columns();
+    uint16_t lo, hi;
 
+    trigger_state = TRIGGERED;
+    x_counter = pre;
+    erase_ahead();
+    for(uint32_t x=0; x<pre; x++) {
+        if(column_hist_get(&history, pre - x, 0, &lo, &hi)) {
+            draw_span(x, 0, lo, hi);
+        }
+        if(column_hist_get(&history, pre - x, 1, &lo, &hi)) {
+            draw_span(x, 1, lo, hi);
+        }
+    }
+}
+
+/*
+ * Plot a sample in roll mode.
+ * There is no trigger, a finished column replaces the oldest column
+ * in the trace and is written to the LCD by display().
+ */
+void plot_roll(uint32_t x, uint32_t y)
+{
+    column_add(&column_ch1, x);
+    column_add(&column_ch2, y);
+    if(timebase_advance(&timebase)) {
+        scope_trace_clear_column(&trace, roll_pos);
+        draw_column(roll_pos);
+        roll_pos = (roll_pos + 1) % WIDTH;
+    }
+}
+
+/*
+ * Plot a sample on the time based display
+ */
+void plot_time(sample_t s)
+{
     /*
-     * This is the part where we read the values from the ADC.
-     * Note that the ADC has already been started so we only need to
-     * wait for the conversion to be complete (whic hshould already be finished by now).
-     * After reading the value, we trigger the ADC to start sampling again.
-     * In this way, we do not have to wait for a conversion to finish, saving ~ 3.5 us
+     * Time based mode
+     * The samples are collected per column (see column.h) and the column is
+     * drawn when the time base moves the trace to the next pixel.
+     * While waiting for the trigger, the finished columns go into the history
+     * so the pre-trigger columns can be drawn when the trigger fires.
+     * The x_xounter is the X index in the trace
      */
+    uint32_t x = s.ch1 & SAMPLE_VALUE;
+    uint32_t y = s.ch2 & SAMPLE_VALUE;
+    uint32_t px;
+
+    if(rolling) {
+        plot_roll(x, y);
+        return;
+    }
+    if(trigger_state == TRIGGER_DONE) {
+        return; // Wait for the sweep to be pushed
+    }
+
+    column_add(&column_ch1, x);
+    column_add(&column_ch2, y);
+    if((trigger_state == TRIGGER_WAITING) && trigger_sample(&trig, s)) {
+        start_trace(); // The current column is the first one after the trigger
+    }
 
-    while(adc->adc0->isConverting() || adc->adc1->isConverting());
-    x = adc->adc0->readSingle();
-    y = adc->adc1->readSingle();
-
-    adc->startSynchronizedSingleRead(0, 1); // Restart the ADC
-    if(samples_per_pixel == 0) {
-        /*
-         * For now (purely testing purposes) I implemented a fixed scaling
-         * This should be replaced with the calibration procedure as used in the TeensyLogger
-         *
-         * For now this just scales the 0 - 3.3 V signal to the full scale of the scope display
-         * (x = 0..400 and y = 0..320)
-         */
-        // Fixed scaling to go from 0..1024 to 0..400 for X and 0..320 for Y
-        x *= 100;
-        x /= 256; // x = x/2.56
-        y *= 10;
-        y /= 32; // y = y/3.2
-
-        /*
-         * Clip the X and Y values to fall inside of the display area.
-         * We are leaving the border free to keep the white border around the image
-         */
-        if(x<1) x=1;
-        if(x>398) x=398;
-        if(y<1) y=1;
-        if(y>318) y=318;
-
-        /*
-         * We now have a valid X,Y position inside the XY display image.
-         * The pixel[x][y] matrix contains the brightness for each pixel
-         * To mimic the analog phosphor style CRT display, 4 parameters are
-         * being used:
-         * - burn_start is the initial intensity of the pixel as soon the 'beam' hits the screen
-         * - burn_inc   determines how fast the intensity of a pixel increases
-         *              (a slow moving beam results in more light being emited by the phosphor
-         * - burn_max   is the maximum intensity of the 'phosphor'
-         *              This is being used to prevent a "burn in" situation where a pixel
-         *              is never extinguished.
-         *              When the maximum intensity has been reached, pixels around the current pixel
-         *              will also be lit to increase the size of the dot/line in a similar way as 
-         *              on a CRT.
-         * - decay_val  Is the speed at which a pixel will extinguish again.
-         *              This has to be slower than increasing the intensity so we only do this
-         *              one line at a time. At the default 100 us interrupt rate, this performs
-         *              a full screen decay cycle in 3.2 ms
-         */
-    
-        // Increase pixel intensity
-        if(pixel[x][y] == 0) {
-            pixel[x][y] = burn_start; // Initial value
+    px = timebase_advance(&timebase);
+    if(px == 0) {
+        return;
+    }
+    if(trigger_state == TRIGGERED) {
+        draw_column(x_counter);
+        x_counter += px;
+        if(x_counter >= WIDTH) {
+            x_counter = WIDTH;
+            trigger_state = TRIGGER_DONE;
         } else {
-            pixel[x][y]+=burn_inc;   // Increment brightness when pixel is already lit
+            erase_ahead();
         }
-
-        // Increase dot size when the maximum intensity has been reached
-        if(pixel[x][y] > burn_max) {
-            pixel[x-1][y-1] += burn_inc;
-            pixel[x-1][y] += burn_inc;
-            pixel[x-1][y+1] += burn_inc;
-            pixel[x][y-1] += burn_inc;
-            pixel[x][y+1] += burn_inc;
-            pixel[x+1][y-1] += burn_inc;
-            pixel[x+1][y] += burn_inc;
-            pixel[x+1][y+1] += burn_inc;
+    } else {
+        column_hist_add(&history, &column_ch1, &column_ch2, acquire_mode);
+        column_start(&column_ch1);
+        column_start(&column_ch2);
+        for(uint32_t i=1; i<px; i++) { // Skipped columns are empty
+            column_hist_add(&history, &column_ch1, &column_ch2, acquire_mode);
         }
+    }
+}
 
-        // decay one line
-        y=cnt;
-        for(x=0; x < WIDTH; x++) {
-            if(pixel[x][y] >= decay_val) {
-                if(pixel[x][y] > burn_max) pixel[x][y] = burn_max;
-                pixel[x][y] -= decay_val;
-            }
-            else {
-                pixel[x][y] = 0;
-            }
+/*
+ * Rasterizer
+ * Takes the samples out of the sample ring and plots them.
+ * At most one ring full of samples is handled per call so the
+ * display update is not held up when sampling goes faster than plotting.
+ */
+void rasterize()
+{
+    sample_t batch[RASTER_BATCH];
+    uint32_t total = 0;
+    uint32_t n;
+
+    uint32_t start = ARM_DWT_CYCCNT;
+
+    digitalWriteFast(9,1); // Use pin 9 to measure the time spent plotting
+    PERF_BEGIN(PERF_RASTER);
+    if(stream.on) {
+        uint32_t overruns = sample_ring.overruns.load();
+
+        if(overruns < stream_overruns) stream_overruns = 0; // The ring has been reset
+        stream_lose(&stream, overruns - stream_overruns);
+        stream_overruns = overruns;
+        if(stream.interval != acq_interval()) {
+            stream_start(&stream, acq_interval());
         }
-        cnt++;
-        if(cnt >= HEIGHT) cnt=0;
-    } else {
-        /*
-         * Time based mode
-         * The sample_counter counts from 0 to samples_per_pixel
-         * and the x_xounter is the X index in the pixel[x][y] matrix
-         */
-        uint32_t ch1, ch2;
-        int trigger;
-    digitalWriteFast(9,1);
-
-        if(x_counter < 400) {
-            // Only add a new pixel when the end of the display is not reached
-
-            // Fixed scaling to go from 0..1024 to 0..400 for X and 0..320 for Y
-            ch1 = x * 100;
-            ch1 /= 512; // ch1 = x/5.12
-            ch2 = y * 100;
-            ch2 /= 512; // ch1 = x/5.12
-            ch2 += 160;
-
-            // ToDo: wait for trigger (TRIGGER_IN or ch1/ch2 level rise/fall)
-            trigger = digitalReadFast(TRIGGER_IN);
-
-            switch(trigger_state) {
-                case TRIGGER_START:
-                    if(trigger == HIGH) trigger_state = TRIGGER_WAITING;
-                    break;
-                case TRIGGER_WAITING:
-                    if(trigger == HIGH)
-                        break;
-                    // Continue when trigger is LOW (falling edge detected)
-                    trigger_state = TRIGGERED;
-                    // immediately start recording data
-                case TRIGGERED:
-                    digitalWriteFast(9, 1);
-                    if((ch1 > 0) && (ch1 < 319)) {
-                        pixel[x_counter][ch1]   = 0b1111100000011111; // Red RRRRRGGGGGGBBBBB
-                        pixel[x_counter][ch1+1] = 0b1111100000011111;
-                    }
-                    if((ch2 > 0) && (ch2 < 319)) {
-                        pixel[x_counter][ch2]   = 0b1111111111100000; // Yellow (red + green)
-                        pixel[x_counter][ch2]   = 0b1111111111100000;
-                    }
-
-                    if(++sample_counter == samples_per_pixel) {
-                      x_counter++;
-                      sample_counter = 0;
-                    }
-                    if(x_counter >= 400) trigger_state = TRIGGER_DONE;
-                    digitalWriteFast(9, 0);
-                    break;
+    }
+    while((total < SAMPLE_RING_SIZE) && (n = sample_ring_pop(&sample_ring, batch, RASTER_BATCH)) > 0) {
+        if(stream.on) {
+            stream_put(&stream, batch, n);
+        }
+        for(uint32_t i=0; i<n; i++) {
+            uint32_t x = batch[i].ch1 & SAMPLE_VALUE;
+            uint32_t y = batch[i].ch2 & SAMPLE_VALUE;
+
+            if(!time_mode) {
+                plot_xy(x, y);
+            } else {
+                plot_time(batch[i]);
             }
         }
+        total += n;
+    }
+    if(total > 0) {
+        PERF_END(PERF_RASTER); // Only the loops that plotted samples
+        load.raster_cycles += ARM_DWT_CYCCNT - start;
+        load.raster_samples += total;
     }
-    
-    digitalWriteFast(11,0);
+    digitalWriteFast(9,0);
 }
 
-void display(void)
+/*
+ * Phosphor decay for the XY display
+ * All lines are decayed by the amount that belongs to the time elapsed since
+ * the previous pass. Lines with lit pixels change and have to be pushed again.
+ */
+void decay()
 {
-    digitalWriteFast(10,1); // Use pin 10 to measure the time needed to write a full image
-    if(samples_per_pixel == 0) {
-        // XY display
-        lcd.draw_xy_scope(0, 0, WIDTH, HEIGHT, (uint16_t *)pixel);
-    } else {
-        // Time based display
-
-        if(x_counter == 400) {
-            lcd.draw_scope(0, 0, WIDTH, HEIGHT, (uint16_t *)pixel);
-            sample_counter = 0;
-            trigger_state = TRIGGER_START;
-            x_counter = 0;
-            memset(pixel, 0, sizeof(pixel));
+    uint16_t amount = phosphor_decay_step(&decay_sched, micros(), decay_val);
+
+    if(amount == 0) {
+        return;
+    }
+    PERF_BEGIN(PERF_DECAY);
+    for(int line=0; line<HEIGHT; line++) {
+        if(phosphor_decay(pixel[line], WIDTH, burn_max, amount)) {
+            mark_dirty_line(line);
         }
     }
+    PERF_END(PERF_DECAY);
+}
+
+/*
+ * Called by the push engine when a full image has been written
+ */
+void frame_done(void *ctx)
+{
     digitalWriteFast(10,0);
 }
 
+/*
+ * Push the columns of the sweep that changed since the previous loop.
+ * First the finished columns, then the erased columns ahead of them.
+ * A new sweep starts after the last column has been pushed.
+ */
+void push_sweep()
+{
+    int n = 0;
+
+    if((x_counter >= WIDTH) && (shown_x >= WIDTH)) {
+        restart_sweep();
+        return;
+    }
+    if((shown_x == x_counter) && (shown_erase >= erase_pos)) {
+        return;
+    }
+    digitalWriteFast(10,1); // Use pin 10 to measure the time needed to write the columns
+    PERF_BEGIN(PERF_PUSH);
+    while((shown_x < x_counter) && (n < PUSH_COLUMNS)) {
+        lcd.draw_scope_column(0, 0, &trace, shown_x++);
+        n++;
+    }
+    if(shown_erase < shown_x) shown_erase = shown_x; // Already pushed with the new trace
+    while((shown_erase < erase_pos) && (n < PUSH_COLUMNS)) {
+        lcd.draw_scope_column(0, 0, &trace, shown_erase++);
+        n++;
+    }
+    PERF_END(PERF_PUSH);
+    digitalWriteFast(10,0);
+}
+
+void update_display()
+{
+    if(rolling) {
+        // Roll mode, write the new columns and scroll the last one to the right edge
+        uint32_t last = roll_shown;
+
+        if(roll_shown == roll_pos) {
+            return;
+        }
+        digitalWriteFast(10,1);
+        PERF_BEGIN(PERF_PUSH);
+        while(roll_shown != roll_pos) {
+            last = roll_shown;
+            lcd.draw_scope_column(0, 0, &trace, last);
+            roll_shown = (roll_shown + 1) % WIDTH;
+        }
+        lcd.scroll_to(last);
+        PERF_END(PERF_PUSH);
+        digitalWriteFast(10,0);
+        return;
+    }
+    if(time_mode) {
+        // Time based display, push the new columns every loop
+        push_sweep();
+        return;
+    }
+    if(lcd_push.busy()) {
+        PERF_BEGIN(PERF_PUSH);
+        lcd_push.service(PUSH_LINES);
+        PERF_END(PERF_PUSH);
+        return;
+    }
+    if((millis() - frame_time) < FRAME_INTERVAL) {
+        return;
+    }
+
+    // XY display, only push the lines that have changed since the last frame
+    decay();
+    for(int i=0; i<DIRTY_WORDS; i++) {
+        frame_lines[i] = dirty_lines[i];
+        dirty_lines[i] = 0;
+    }
+    lcd_push.begin(0, 0, WIDTH, HEIGHT, scope_render_xy_line, &scope_image, frame_done, frame_lines);
+    frame_time = millis();
+    digitalWriteFast(10,1); // Use pin 10 to measure the time needed to write a full image
+    PERF_BEGIN(PERF_PUSH);
+    lcd_push.service(PUSH_LINES);
+    PERF_END(PERF_PUSH);
+}
+
+/*
+ * Update the display and count the time spent for the CPU load
+ */
+void display(void)
+{
+    uint32_t start = ARM_DWT_CYCCNT;
+
+    update_display();
+    load.display_cycles += ARM_DWT_CYCCNT - start;
+    load_update();
+}
+
+/*
+ * Send the queued stream frames that fit in the USB serial transmit buffer.
+ * Only whole frames are written so CLI output always falls between two frames.
+ */
+void send_stream()
+{
+    const stream_frame_t *f;
+
+    while((f = stream_frame(&stream)) && (Serial.availableForWrite() >= f->len)) {
+        Serial.write(f->data, f->len);
+        stream_sent(&stream);
+    }
+}
+
 void setup()
 {
     Serial.begin(115200);
@@ -459,15 +1445,19 @@ void setup()
     adc->adc0->setResolution(ADC_RESOLUTION);
     adc->adc0->setConversionSpeed(ADC_CONVERSION_SPEED::HIGH_SPEED);
     adc->adc0->setSamplingSpeed(ADC_SAMPLING_SPEED::VERY_HIGH_SPEED);
-    adc->adc0->setAveraging(ADC_OVERSAMPLING);
     adc->adc1->setResolution(ADC_RESOLUTION);
     adc->adc1->setConversionSpeed(ADC_CONVERSION_SPEED::HIGH_SPEED);
     adc->adc1->setSamplingSpeed(ADC_SAMPLING_SPEED::VERY_HIGH_SPEED);
-    adc->adc1->setAveraging(ADC_OVERSAMPLING);
   
 // Setup the LCD
     lcd.InitLCD();
     lcd.clrScr();
+    if(lcd.check_bus()) {
+        Serial.println("Error: LCD data lines not mapped correctly");
+    }
+    if(phosphor_check()) {
+        Serial.printf("Error: %s decay kernel does not match the reference\n", phosphor_kernel());
+    }
     Serial.println("Initialized");
   
     pinMode(11, OUTPUT); // Pins 10 and 11 are used for debugging
@@ -482,14 +1472,36 @@ void setup()
     lcd.fillRect(0,0, 479, 319);
     lcd.setColor(0,0,0);
     lcd.fillRect(1, 1, WIDTH-1, HEIGHT-1);
+    reticle_build(&reticle, WIDTH, HEIGHT, XDIV, YDIV, SUBDIV, RETICLE_FULL);
+    palette_build(&palette, PALETTE_CLASSIC, 0);
+    beam_init(&beam, (uint8_t *)pixel, WIDTH, HEIGHT, dirty_lines);
+    beam_burn(&beam, burn_start, burn_inc, burn_max);
+    trigger_init(&trig);
+    perf_reset();
+    stream_init(&stream, ADC_RESOLUTION);
+    mark_all_dirty();
+
+    EEPROM.get(CALIB_EEPROM_ADDR, calib);
+    if(!calib_valid(&calib)) {
+        calib_init(&calib); // Not calibrated yet
+    }
+    build_luts();
+
+    trace.sx = WIDTH;
+    trace.sy = HEIGHT;
+    trace.color[0] = 0b1111100000011111; // CH1 Magenta RRRRRGGGGGGBBBBB
+    trace.color[1] = 0b1111111111100000; // CH2 Yellow (red + green)
+    trace.reticle = &reticle;
+    scope_trace_clear(&trace);
 
-    adc->startSynchronizedSingleRead(0, 1); // start ADC, read A0 and A1 channels
-    sampling_timer.begin(sample, SAMPLING_INTERVAL); // Start sampling at 25 us interval
+    acq_init(adc, TRIGGER_IN, &sample_ring);
+    acq_start(SAMPLING_INTERVAL); // Start sampling at 25 us interval
 }
 
 void loop()
 {
   cli_loop();
+  rasterize();
   display();
-  delay(10);
+  send_stream();
 }
@@ -0,0 +1,335 @@
+/*
+ * acquisition.cpp - Sampling of the X/Y (CH1/CH2) analog inputs
+ */
+
+#include <ADC.h>
+#include <IntervalTimer.h>
+#include <DMAChannel.h>
+#include "acquisition.h"
+#include "perf.h"
+
+#define ACQ_HALF (ACQ_DMA_SAMPLES/2)
+
+static ADC           *acq_adc;
+static sample_ring_t *acq_ring;
+static uint8_t        acq_trigger_pin;
+static uint32_t       acq_sample_interval;
+static bool           acq_running;
+static bool           acq_dma;
+static uint8_t        acq_avg_setting = ACQ_AUTO_AVERAGING;
+static acq_timing_t   timing;
+
+static IntervalTimer  sampling_timer;
+
+/*
+ * DMA buffers. These are in DMAMEM (cached RAM) so the cache has to be
+ * invalidated before the CPU reads a half that was filled by DMA.
+ * Each half is a multiple of the 32 bytes cache line size.
+ */
+static DMAChannel dma_ch1, dma_ch2, dma_trig;
+DMAMEM static volatile uint16_t buf_ch1[ACQ_DMA_SAMPLES] __attribute__((aligned(32)));
+DMAMEM static volatile uint16_t buf_ch2[ACQ_DMA_SAMPLES] __attribute__((aligned(32)));
+DMAMEM static volatile uint8_t  buf_trig[ACQ_DMA_SAMPLES] __attribute__((aligned(32)));
+static volatile uint8_t *trig_port;  // Byte of the GPIO PSR register with the trigger input
+static uint8_t           trig_mask;
+
+/*
+ * Timer based sampling
+ * Reads the ADC values and the trigger input and hands them to the
+ * rasterizer through the sample ring.
+ */
+static void acq_sample()
+{
+    uint32_t stamp = ARM_DWT_CYCCNT;
+    sample_t s;
+
+    digitalWriteFast(11,1); // Use pin 11 to measure the time spent in the interrupt
+    PERF_BEGIN(PERF_ISR);
+    acq_timing_event(&timing, stamp, 1);
+
+    /*
+     * This is the part where we read the values from the ADC.
+     * Note that the ADC has already been started so we only need to
+     * wait for the conversion to be complete (whic hshould already be finished by now).
+     * After reading the value, we trigger the ADC to start sampling again.
+     * In this way, we do not have to wait for a conversion to finish, saving ~ 3.5 us
+     */
+
+    while(acq_adc->adc0->isConverting() || acq_adc->adc1->isConverting());
+    s.ch1 = acq_adc->adc0->readSingle();
+    s.ch2 = acq_adc->adc1->readSingle();
+
+    acq_adc->startSynchronizedSingleRead(0, 1); // Restart the ADC
+
+    if(digitalReadFast(acq_trigger_pin) == HIGH) {
+        s.ch1 |= SAMPLE_TRIGGER;
+    }
+    sample_ring_push(acq_ring, s);
+
+    PERF_END(PERF_ISR);
+    timing.busy += ARM_DWT_CYCCNT - stamp;
+    digitalWriteFast(11,0);
+}
+
+/*
+ * Number of transfers a DMA channel has done in the current pass through its buffer.
+ * CITER counts down and is reloaded at the end of the buffer.
+ */
+static inline uint32_t dma_position(DMAChannel &ch)
+{
+    return ACQ_DMA_SAMPLES - ch.TCD->CITER_ELINKNO;
+}
+
+/*
+ * DMA interrupt at half and full completion of the ADC1 (CH2) buffer.
+ * Right after the half way interrupt CITER is at (or just below) half of the buffer,
+ * after completion it has been reloaded to the full buffer size.
+ */
+static void acq_dma_isr()
+{
+    uint32_t stamp = ARM_DWT_CYCCNT;
+    acq_block_t blk;
+    uint32_t first;
+    int timeout = 100;
+
+    dma_ch2.clearInterrupt();
+    digitalWriteFast(11,1);
+    PERF_BEGIN(PERF_DMA);
+    acq_timing_event(&timing, stamp, ACQ_HALF);
+
+    first = (dma_position(dma_ch2) >= ACQ_HALF) ? 0 : ACQ_HALF;
+
+    /*
+     * Both ADCs are started by their own timer at the same rate so
+     * ADC0 (and the trigger copy linked to it) may be a conversion behind.
+     */
+    while(((dma_position(dma_trig) >= ACQ_HALF) != (first == 0)) && timeout--);
+
+    arm_dcache_delete((void *)&buf_ch1[first], ACQ_HALF * sizeof(buf_ch1[0]));
+    arm_dcache_delete((void *)&buf_ch2[first], ACQ_HALF * sizeof(buf_ch2[0]));
+    arm_dcache_delete((void *)&buf_trig[first], ACQ_HALF * sizeof(buf_trig[0]));
+
+    blk.ch1 = &buf_ch1[first];
+    blk.ch2 = &buf_ch2[first];
+    blk.trigger = &buf_trig[first];
+    blk.trigger_mask = trig_mask;
+    blk.count = ACQ_HALF;
+    acq_block_to_ring(&blk, acq_ring);
+
+    /*
+     * The DMA must still be in the other half of the buffers, otherwise
+     * it has been overwriting this half while it was copied.
+     */
+    if((dma_position(dma_ch2) >= ACQ_HALF) == (first != 0)) {
+        timing.overruns++;
+    }
+    PERF_END(PERF_DMA);
+    timing.busy += ARM_DWT_CYCCNT - stamp;
+    digitalWriteFast(11,0);
+#if defined(__arm__)
+    asm("DSB");
+#endif
+}
+
+static void start_dma(uint32_t interval)
+{
+    dma_ch1.begin();
+    dma_ch1.source((volatile uint16_t &)ADC1_R0);
+    dma_ch1.destinationBuffer(buf_ch1, sizeof(buf_ch1));
+    dma_ch1.triggerAtHardwareEvent(DMAMUX_SOURCE_ADC1);
+
+    // Copy the trigger input after every ADC0 result
+    dma_trig.begin();
+    dma_trig.source(*trig_port);
+    dma_trig.destinationBuffer(buf_trig, sizeof(buf_trig));
+    dma_trig.triggerAtTransfersOf(dma_ch1);
+
+    dma_ch2.begin();
+    dma_ch2.source((volatile uint16_t &)ADC2_R0);
+    dma_ch2.destinationBuffer(buf_ch2, sizeof(buf_ch2));
+    dma_ch2.triggerAtHardwareEvent(DMAMUX_SOURCE_ADC2);
+    dma_ch2.interruptAtHalf();
+    dma_ch2.interruptAtCompletion();
+    dma_ch2.attachInterrupt(acq_dma_isr);
+
+    dma_trig.enable();
+    dma_ch1.enable();
+    dma_ch2.enable();
+
+    acq_adc->adc0->enableDMA();
+    acq_adc->adc1->enableDMA();
+    acq_adc->adc0->startSingleRead(0);
+    acq_adc->adc1->startSingleRead(1);
+    acq_adc->adc0->startTimer(1000000 / interval);
+    acq_adc->adc1->startTimer(1000000 / interval);
+}
+
+static void stop_dma()
+{
+    acq_adc->adc0->stopTimer();
+    acq_adc->adc1->stopTimer();
+    acq_adc->adc0->disableDMA();
+    acq_adc->adc1->disableDMA();
+    dma_ch2.disable();
+    dma_ch1.disable();
+    dma_trig.disable();
+}
+
+void acq_init(ADC *adc, uint8_t trigger_pin, sample_ring_t *ring)
+{
+    const volatile uint32_t *psr;
+    uint32_t mask;
+    int bit = 0;
+
+    acq_adc = adc;
+    acq_ring = ring;
+    acq_trigger_pin = trigger_pin;
+
+    /*
+     * Find the byte of the GPIO pad status register (PSR, 2 words after DR)
+     * that contains the trigger input for the DMA copy.
+     */
+    psr = digital_pin_to_info_PGM[trigger_pin].reg + 2;
+    mask = digital_pin_to_info_PGM[trigger_pin].mask;
+    while(!(mask & (1UL << bit))) bit++;
+    trig_port = (volatile uint8_t *)psr + (bit / 8);
+    trig_mask = 1 << (bit % 8);
+}
+
+/*
+ * Select the ADC hardware averaging that fits in the sample interval.
+ * This is the highest setting up to ACQ_MAX_AVERAGING, or up to the setting
+ * of acq_set_averaging(), that allows both conversions to finish within the interval.
+ */
+uint8_t acq_averaging(uint32_t interval)
+{
+    uint32_t avg = (acq_avg_setting == ACQ_AUTO_AVERAGING) ? ACQ_MAX_AVERAGING : acq_avg_setting;
+
+    while((avg > 1) && (avg * ACQ_CONVERSION_NS > interval * 1000)) {
+        avg /= 2;
+    }
+    return (avg < 4) ? 0 : avg;
+}
+
+/*
+ * Set the ADC averaging (0, 4, 8, 16 or 32), ACQ_AUTO_AVERAGING uses the
+ * highest averaging up to ACQ_MAX_AVERAGING. A setting is still lowered
+ * when it does not fit in the sample interval (see acq_averaging()).
+ * Takes effect at the next acq_start().
+ */
+void acq_set_averaging(uint8_t avg)
+{
+    acq_avg_setting = avg;
+}
+
+uint8_t acq_averaging_setting()
+{
+    return acq_avg_setting;
+}
+
+/*
+ * Check if sampling with the given interval and averaging can be done.
+ * isr_ns and raster_ns are the time per sample in the interrupt and in the
+ * rasterizer, display_pct the part of the CPU time used for the decay and the
+ * LCD update. These are measured with the current settings, 0 when unknown.
+ * Returns 0 when the setting can be met, otherwise the reason why not.
+ */
+const char *acq_check(uint32_t interval, uint8_t avg, uint32_t isr_ns, uint32_t raster_ns, uint32_t display_pct)
+{
+    static char msg[128];
+    uint32_t conversion = ((avg == ACQ_AUTO_AVERAGING) ? 1 : avg) * ACQ_CONVERSION_NS;
+    uint32_t load;
+
+    if(conversion < ACQ_CONVERSION_NS) conversion = ACQ_CONVERSION_NS; // No averaging
+    if(conversion > interval * 1000) {
+        snprintf(msg, sizeof(msg), "averaging %d needs a sample interval of at least %d us",
+                 avg, (int)((conversion + 999) / 1000));
+        return msg;
+    }
+    if(!(interval < ACQ_TIMER_MIN_INTERVAL) && (isr_ns >= interval * 1000)) {
+        snprintf(msg, sizeof(msg), "the sample interrupt takes %1.2f us, more than the interval",
+                 isr_ns / 1000.0);
+        return msg;
+    }
+    load = (isr_ns + raster_ns) * 100 / (interval * 1000) + display_pct;
+    if(load > ACQ_MAX_LOAD) {
+        snprintf(msg, sizeof(msg), "sampling every %d us needs %d%% of the CPU time (%1.2f us per sample, %d%% for the display)",
+                 (int)interval, (int)load, (isr_ns + raster_ns) / 1000.0, (int)display_pct);
+        return msg;
+    }
+    return 0;
+}
+
+/*
+ * Copy of the timing statistics of the current acquisition
+ */
+void acq_timing(acq_timing_t *t)
+{
+    noInterrupts();
+    *t = timing;
+    interrupts();
+}
+
+void acq_timing_reset()
+{
+    uint32_t period = timing.period;
+
+    noInterrupts();
+    memset(&timing, 0, sizeof(timing));
+    timing.period = period;
+    interrupts();
+}
+
+/*
+ * Start sampling with the given interval in us.
+ * Returns false when the interval is out of range.
+ */
+bool acq_start(uint32_t interval)
+{
+    uint8_t avg;
+
+    if((interval < ACQ_MIN_INTERVAL) || (interval > ACQ_MAX_INTERVAL)) {
+        return false;
+    }
+    acq_stop();
+
+    avg = acq_averaging(interval);
+    acq_adc->adc0->setAveraging(avg);
+    acq_adc->adc1->setAveraging(avg);
+
+    acq_sample_interval = interval;
+    acq_dma = (interval < ACQ_TIMER_MIN_INTERVAL);
+    timing.period = interval * (F_CPU_ACTUAL / 1000000) * (acq_dma ? ACQ_HALF : 1);
+    acq_timing_reset();
+    if(acq_dma) {
+        start_dma(interval);
+    } else {
+        acq_adc->startSynchronizedSingleRead(0, 1); // start ADC, read A0 and A1 channels
+        sampling_timer.begin(acq_sample, interval);
+    }
+    acq_running = true;
+    return true;
+}
+
+void acq_stop()
+{
+    if(!acq_running) {
+        return;
+    }
+    if(acq_dma) {
+        stop_dma();
+    } else {
+        sampling_timer.end();
+    }
+    acq_running = false;
+}
+
+uint32_t acq_interval()
+{
+    return acq_sample_interval;
+}
+
+bool acq_dma_active()
+{
+    return acq_running && acq_dma;
+}
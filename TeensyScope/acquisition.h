@@ -0,0 +1,147 @@
+/*
+ * acquisition.h - Sampling of the X/Y (CH1/CH2) analog inputs
+ *
+ * Two acquisition paths deliver samples into the sample ring:
+ *  - Timer: an IntervalTimer interrupt reads both ADCs and the trigger input
+ *           for every sample. Used for sample intervals of ACQ_TIMER_MIN_INTERVAL
+ *           and up.
+ *  - DMA:   both ADCs are started by hardware timers (QuadTimer via ADC_ETC) and
+ *           DMA moves the results into circular buffers. A DMA channel linked to the
+ *           ADC0 channel copies the GPIO port with the trigger input for every sample.
+ *           The DMA interrupt at half and full completion hands the finished half of
+ *           the buffers to the consumer as an acq_block_t.
+ *
+ * The acq_block_t consumer does not depend on the Arduino environment so blocks
+ * with synthetic data can be fed into the pipeline on a host.
+ *
+ * Both paths timestamp their interrupts with the cycle counter (see acq_timing_t)
+ * so late interrupts, missed sample periods and DMA buffer overruns are counted
+ * instead of silently shifting or dropping samples.
+ */
+
+#ifndef acquisition_h
+#define acquisition_h
+
+#include <stdint.h>
+#include "sample_ring.h"
+
+#define ACQ_MIN_INTERVAL        1     // us
+#define ACQ_MAX_INTERVAL        1000  // us
+#define ACQ_TIMER_MIN_INTERVAL  10    // us, shorter intervals use DMA
+#define ACQ_DMA_SAMPLES         1024  // Samples per channel in the DMA buffers (2 halves)
+#define ACQ_CONVERSION_NS       750   // Estimated time for a single ADC conversion
+
+/*
+ * Use hardware oversampling of the ADC.
+ * This means that after starting an ADC conversion, the ADC will take
+ * the given number of samples and report the average of this as the final result.
+ * The averaging is lowered for short sample intervals, see acq_averaging().
+ */
+#define ACQ_MAX_AVERAGING       16    // Can be set to 0, 4, 8, 16 or 32
+#define ACQ_AUTO_AVERAGING      0xff  // acq_set_averaging(): highest averaging that fits
+
+/*
+ * Settings are refused when sampling and plotting would use more than
+ * this part of the CPU time, in %
+ */
+#define ACQ_MAX_LOAD            90
+
+/*
+ * Timing of the acquisition interrupts.
+ * An event is a sample (timer) or a half buffer (DMA). An event is late when
+ * it comes more than a quarter period after the previous one, the periods
+ * in between without an event are missed. The histogram holds the deviation
+ * from the period, bucket n counts deviations below 2^n cycles, the last
+ * bucket also everything above.
+ */
+#define ACQ_JITTER_BUCKETS      16
+
+typedef struct acq_timing_s
+{
+    uint32_t period;     // Expected cycles between two events
+    uint32_t last;       // Cycle counter at the previous event
+    uint32_t events;
+    uint32_t samples;    // Samples delivered by the events
+    uint32_t late;
+    uint32_t missed;     // Sample periods without a sample
+    uint32_t overruns;   // DMA: half buffers overwritten while they were copied
+    uint32_t max_dev;    // Largest deviation from the period in cycles
+    uint64_t busy;       // Cycles spent in the interrupt
+    uint32_t hist[ACQ_JITTER_BUCKETS];
+} acq_timing_t;
+
+/*
+ * A block of samples, ch1[i], ch2[i] and trigger[i] belong to the same sample.
+ * trigger[i] is the GPIO port byte that contains the trigger input,
+ * trigger_mask selects the trigger input in this byte.
+ */
+typedef struct acq_block_s
+{
+    const volatile uint16_t *ch1;
+    const volatile uint16_t *ch2;
+    const volatile uint8_t  *trigger;
+    uint8_t  trigger_mask;
+    uint32_t count;
+} acq_block_t;
+
+class ADC;
+
+void     acq_init(ADC *adc, uint8_t trigger_pin, sample_ring_t *ring);
+bool     acq_start(uint32_t interval);
+void     acq_stop();
+uint32_t acq_interval();
+bool     acq_dma_active();
+uint8_t  acq_averaging(uint32_t interval);
+void     acq_set_averaging(uint8_t avg);
+uint8_t  acq_averaging_setting();
+const char *acq_check(uint32_t interval, uint8_t avg, uint32_t isr_ns, uint32_t raster_ns, uint32_t display_pct);
+void     acq_timing(acq_timing_t *t);
+void     acq_timing_reset();
+
+/*
+ * Add an event at cycle counter value stamp.
+ * samples is the number of samples of the event, a missed period of
+ * a DMA block is counted as that many missed samples.
+ */
+static inline void acq_timing_event(acq_timing_t *t, uint32_t stamp, uint32_t samples)
+{
+    uint32_t delta, dev, bucket;
+    int32_t  err;
+
+    t->samples += samples;
+    if(t->events++ == 0) {
+        t->last = stamp;
+        return;
+    }
+    delta = stamp - t->last;
+    t->last = stamp;
+    err = (int32_t)(delta - t->period);
+    dev = (err < 0) ? -err : err;
+    bucket = 31 - __builtin_clz(dev | 1);
+    if(bucket >= ACQ_JITTER_BUCKETS) bucket = ACQ_JITTER_BUCKETS - 1;
+    t->hist[bucket]++;
+    if(dev > t->max_dev) t->max_dev = dev;
+    if(err > (int32_t)(t->period / 4)) {
+        t->late++;
+        t->missed += ((delta + t->period / 2) / t->period - 1) * samples;
+    }
+}
+
+/*
+ * Move a block of samples into the sample ring
+ */
+static inline void acq_block_to_ring(const acq_block_t *blk, sample_ring_t *ring)
+{
+    for(uint32_t i=0; i<blk->count; i++) {
+        sample_t s;
+
+        s.ch1 = blk->ch1[i] & SAMPLE_VALUE;
+        s.ch2 = blk->ch2[i] & SAMPLE_VALUE;
+        if(blk->trigger[i] & blk->trigger_mask) {
+            s.ch1 |= SAMPLE_TRIGGER;
+        }
+        sample_ring_push(ring, s);
+    }
+}
+
+#endif
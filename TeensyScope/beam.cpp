@@ -0,0 +1,102 @@
+/*
+ * beam.cpp - Beam interpolation for the XY display
+ */
+
+#include "beam.h"
+#include "phosphor.h"
+
+static uint32_t recip[BEAM_MAX_LEN];  // 65536 / n
+
+void beam_init(beam_t *b, uint8_t *image, int sx, int sy, uint32_t *dirty)
+{
+    recip[0] = 65536;
+    for(int n=1; n<BEAM_MAX_LEN; n++) {
+        recip[n] = 65536 / n;
+    }
+    b->image = image;
+    b->dirty = dirty;
+    b->sx = sx;
+    b->sy = sy;
+    beam_burn(b, 160, 40, 240);
+    beam_off(b);
+}
+
+/*
+ * Set the intensities, see plot_xy() in TeensyScope.ino
+ */
+void beam_burn(beam_t *b, uint16_t start, uint16_t inc, uint16_t max)
+{
+    b->start = (start > 255) ? 255 : start;
+    b->inc = (inc > 255) ? 255 : inc;
+    b->max = (max > 255) ? 255 : max;
+}
+
+/*
+ * Add intensity to pixel x,y: 'start' when the pixel was off, 'inc' when it was lit.
+ * Returns true when the intensity reached the maximum.
+ */
+static inline bool burn(beam_t *b, int x, int y, uint32_t start, uint32_t inc)
+{
+    int line = b->sy - 1 - y;
+    uint8_t *p = &b->image[line * b->sx + (b->sx - 1 - x)];
+
+    b->dirty[line >> 5] |= 1UL << (line & 31);
+    return phosphor_burn(p, (*p == 0) ? start : inc, b->max);
+}
+
+/*
+ * Move the beam to x,y.
+ * When the beam does not move, the pixel gets the full intensity and
+ * when it reaches the maximum the dot grows into the surrounding pixels.
+ * Otherwise the segment from the previous position is drawn, without the
+ * first pixel which was drawn by the previous move.
+ */
+void beam_move(beam_t *b, int x, int y)
+{
+    int dx, dy, len, n;
+    int32_t fx, fy, incx, incy;
+    uint32_t start, inc;
+
+    if((b->x < 0) || ((x == b->x) && (y == b->y))) {
+        b->x = x;
+        b->y = y;
+        if(burn(b, x, y, b->start, b->inc)) {
+            burn(b, x-1, y-1, b->inc, b->inc);
+            burn(b, x-1, y,   b->inc, b->inc);
+            burn(b, x-1, y+1, b->inc, b->inc);
+            burn(b, x,   y-1, b->inc, b->inc);
+            burn(b, x,   y+1, b->inc, b->inc);
+            burn(b, x+1, y-1, b->inc, b->inc);
+            burn(b, x+1, y,   b->inc, b->inc);
+            burn(b, x+1, y+1, b->inc, b->inc);
+        }
+        return;
+    }
+
+    dx = x - b->x;
+    dy = y - b->y;
+    len = (dx < 0) ? -dx : dx;
+    if(dy > len) len = dy;
+    if(-dy > len) len = -dy;
+    if(len >= BEAM_MAX_LEN) len = BEAM_MAX_LEN - 1;
+
+    // Intensity per pixel is inversely proportional to the length, at least 1
+    start = (b->start * recip[len]) >> 16;
+    inc = (b->inc * recip[len]) >> 16;
+    if(start == 0) start = 1;
+    if(inc == 0) inc = 1;
+
+    n = (len > BEAM_MAX_STEPS) ? BEAM_MAX_STEPS : len;
+    incx = dx * (int32_t)recip[n];
+    incy = dy * (int32_t)recip[n];
+    fx = (b->x << 16) + 0x8000;
+    fy = (b->y << 16) + 0x8000;
+    for(int i=1; i<n; i++) {
+        fx += incx;
+        fy += incy;
+        burn(b, fx >> 16, fy >> 16, start, inc);
+    }
+    burn(b, x, y, start, inc); // The end point is always exact
+    b->x = x;
+    b->y = y;
+}
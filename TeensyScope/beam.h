@@ -0,0 +1,50 @@
+/*
+ * beam.h - Beam interpolation for the XY display
+ *
+ * A real CRT beam draws a line between two positions, it does not jump.
+ * beam_move() draws the segment from the previous beam position to the
+ * new one into the intensity image with a fixed point (16.16) DDA.
+ * The beam spends the same time on every segment, so the intensity it
+ * deposits per pixel is inversely proportional to the length of the segment:
+ * a slow moving beam gives a bright dot, a fast moving beam a faint line.
+ *
+ * Only integer arithmetic is used and there are no divisions, the
+ * 1/length factors come from a table. A segment is drawn with at most
+ * BEAM_MAX_STEPS pixels so the worst case time per sample is bounded,
+ * longer segments are drawn as a dotted line.
+ *
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef beam_h
+#define beam_h
+
+#include <stdint.h>
+
+#define BEAM_MAX_LEN    512  // Longest possible segment (in pixels) + 1
+#define BEAM_MAX_STEPS  128  // Max. number of pixels drawn for one segment
+
+typedef struct beam_s
+{
+    uint8_t  *image;    // Intensity image in LCD order (see scope_index())
+    uint32_t *dirty;    // Bitmap with the changed lines, bit n%32 of dirty[n/32] for line n from the top
+    int      sx, sy;    // Size of the image
+    int      x, y;      // Previous beam position, x < 0 when the beam was off
+    uint8_t  start;     // Intensity of a pixel that is hit for the first time
+    uint8_t  inc;       // Intensity added when a pixel is hit again
+    uint8_t  max;       // Max. intensity
+} beam_t;
+
+void beam_init(beam_t *b, uint8_t *image, int sx, int sy, uint32_t *dirty);
+void beam_burn(beam_t *b, uint16_t start, uint16_t inc, uint16_t max);
+void beam_move(beam_t *b, int x, int y);
+
+/*
+ * Turn the beam off, the next beam_move() does not draw a segment
+ */
+static inline void beam_off(beam_t *b)
+{
+    b->x = -1;
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * calibration.cpp - Per channel calibration and ADC value to pixel tables
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calibration.h"
+
+/*
+ * Nominal calibration: 0 V is ADC value 0 and the max. ADC value is CALIB_FULL_SCALE
+ */
+void calib_init(calib_t *cal)
+{
+    cal->magic = CALIB_MAGIC;
+    for(int i=0; i<CALIB_CHANNELS; i++) {
+        cal->ch[i].offset = 0;
+        cal->ch[i].gain = 1.0f;
+    }
+}
+
+/*
+ * Check a calibration read from the EEPROM
+ */
+bool calib_valid(const calib_t *cal)
+{
+    if(cal->magic != CALIB_MAGIC) {
+        return false;
+    }
+    for(int i=0; i<CALIB_CHANNELS; i++) {
+        if((cal->ch[i].offset < 0) || (cal->ch[i].offset >= CALIB_LUT_SIZE) ||
+           !(cal->ch[i].gain >= CALIB_MIN_GAIN) || !(cal->ch[i].gain <= CALIB_MAX_GAIN)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Fill the table with the pixel of every ADC value:
+ *     pixel = pos + (val - offset) * gain * uV per count / uv_div * px_div
+ * The pixel is rounded down, so the nominal calibration gives the
+ * same pixels as the fixed scaling it replaces.
+ */
+void calib_build(uint16_t *lut, const calib_channel_t *ch, const calib_axis_t *axis)
+{
+    double scale = (double)CALIB_FULL_SCALE / CALIB_LUT_SIZE * axis->px_div / axis->uv_div * ch->gain;
+
+    for(int32_t val=0; val<CALIB_LUT_SIZE; val++) {
+        double px = floor(axis->pos + (val - ch->offset) * scale);
+
+        if(px < axis->min) px = axis->min;
+        if(px > axis->max) px = axis->max;
+        lut[val] = (uint16_t)px;
+    }
+}
+
+/*
+ * Parse a voltage like "0.5", "500mv" or "2v", a number without a unit is in V.
+ * Returns the voltage in uV or 0 when the value is not valid.
+ */
+uint32_t calib_parse_volts(const char *s)
+{
+    char *unit;
+    double val = strtod(s, &unit);
+    double scale;
+
+    if((unit == s) || (val <= 0)) {
+        return 0;
+    }
+    if((*unit == '\0') || (strcmp(unit, "v") == 0)) {
+        scale = 1000000.0;
+    } else if(strcmp(unit, "mv") == 0) {
+        scale = 1000.0;
+    } else {
+        return 0;
+    }
+    val = val * scale + 0.5;
+    if((val < 1) || (val > 100000000.0)) {
+        return 0;
+    }
+    return (uint32_t)val;
+}
+
+/*
+ * Print a voltage in uV with a readable unit, e.g. "412.5 mV"
+ */
+void calib_format_volts(uint32_t uv, char *buf, size_t len)
+{
+    if(uv >= 1000000) {
+        snprintf(buf, len, "%g V", uv / 1000000.0);
+    } else {
+        snprintf(buf, len, "%g mV", uv / 1000.0);
+    }
+}
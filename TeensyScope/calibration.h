@@ -0,0 +1,74 @@
+/*
+ * calibration.h - Per channel calibration and ADC value to pixel tables
+ *
+ * The calibration of a channel is the ADC value at 0 V (offset) and a
+ * correction factor on the nominal volts per ADC count (gain). It is set
+ * with the cal command and saved in the EEPROM.
+ *
+ * Together with the volts per division of an axis the calibration gives
+ * the pixel for every possible ADC value. calib_build() fills a table with
+ * these pixels, clipped to the range of the axis, so plotting a sample only
+ * needs one table lookup per axis. The tables are only rebuilt when the
+ * calibration or the volts per division change.
+ *
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef calibration_h
+#define calibration_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CALIB_ADC_BITS     10                     // Must match the ADC resolution
+#define CALIB_LUT_SIZE     (1 << CALIB_ADC_BITS)  // Entries in a table, 4096 for 12 bits
+#define CALIB_LUT_MASK     (CALIB_LUT_SIZE - 1)
+#define CALIB_FULL_SCALE   3300000                // uV, nominal ADC reference (CALIB_LUT_SIZE counts)
+#define CALIB_CHANNELS     2
+
+#define CALIB_MAGIC        0x54534331             // "TSC1", marks a valid calibration in the EEPROM
+
+#define CALIB_MIN_GAIN     0.5f
+#define CALIB_MAX_GAIN     2.0f
+
+typedef struct calib_channel_s
+{
+    int16_t offset;  // ADC value at 0 V
+    float   gain;    // Correction of the nominal volts per ADC count
+} calib_channel_t;
+
+/*
+ * The calibration as it is saved in the EEPROM
+ */
+typedef struct calib_s
+{
+    uint32_t        magic;
+    calib_channel_t ch[CALIB_CHANNELS];
+} calib_t;
+
+/*
+ * Scaling of one axis of the display
+ */
+typedef struct calib_axis_s
+{
+    uint32_t uv_div;    // Volts per division in uV
+    uint16_t px_div;    // Pixels per division
+    int16_t  pos;       // Pixel of 0 V
+    uint16_t min, max;  // Pixels outside this range are clipped
+} calib_axis_t;
+
+void calib_init(calib_t *cal);
+bool calib_valid(const calib_t *cal);
+void calib_build(uint16_t *lut, const calib_channel_t *ch, const calib_axis_t *axis);
+uint32_t calib_parse_volts(const char *s);
+void calib_format_volts(uint32_t uv, char *buf, size_t len);
+
+/*
+ * Pixel of an ADC value
+ */
+static inline uint16_t calib_pixel(const uint16_t *lut, uint32_t val)
+{
+    return lut[val & CALIB_LUT_MASK];
+}
+
+#endif
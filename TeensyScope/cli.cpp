@@ -1,5 +1,6 @@
 #include <arduino.h>
 #include "cli.h"
+#include "perf.h"
 
 #define CLI_MAX_PARAMS 4
 #define CLI_BUF_SIZE 128
@@ -29,7 +30,9 @@ void cli_process_command()
     }
     for(cmd=0; cli_commands[cmd].command[0]; cmd++) {
         if(strcmp(cli_commands[cmd].command, cli_buf) == 0) {
+            PERF_BEGIN(PERF_CLI);
             cli_commands[cmd].func(param_cnt, cli_params);
+            PERF_END(PERF_CLI);
             break;
         } 
     }
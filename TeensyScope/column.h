@@ -0,0 +1,118 @@
+/*
+ * column.h - Decimation of the samples of one column in the time based display
+ *
+ * When more than one sample goes into a column of the display the samples
+ * are collected here and the column is drawn once when it is complete.
+ * The acquisition mode selects what is shown for the column:
+ *  - ACQUIRE_SAMPLE:  the first sample of the column
+ *  - ACQUIRE_PEAK:    a vertical span from the lowest to the highest sample,
+ *                     so short spikes are always visible
+ *  - ACQUIRE_AVERAGE: the average of all samples
+ *
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef column_h
+#define column_h
+
+#include <stdint.h>
+
+#define ACQUIRE_SAMPLE   0
+#define ACQUIRE_PEAK     1
+#define ACQUIRE_AVERAGE  2
+
+typedef struct column_s
+{
+    uint16_t first;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint32_t count;
+} column_t;
+
+static inline void column_start(column_t *c)
+{
+    c->min = 0xffff;
+    c->max = 0;
+    c->sum = 0;
+    c->count = 0;
+}
+
+static inline void column_add(column_t *c, uint16_t val)
+{
+    if(c->count == 0) c->first = val;
+    if(val < c->min) c->min = val;
+    if(val > c->max) c->max = val;
+    c->sum += val;
+    c->count++;
+}
+
+/*
+ * The span to draw for the column in the given mode.
+ * Returns false when the column has no samples.
+ */
+static inline bool column_span(const column_t *c, uint8_t mode, uint16_t *lo, uint16_t *hi)
+{
+    if(c->count == 0) {
+        return false;
+    }
+    switch(mode) {
+        case ACQUIRE_PEAK:
+            *lo = c->min;
+            *hi = c->max;
+            break;
+        case ACQUIRE_AVERAGE:
+            *lo = *hi = (c->sum + c->count/2) / c->count;
+            break;
+        default:
+            *lo = *hi = c->first;
+            break;
+    }
+    return true;
+}
+
+/*
+ * History of finished columns, used for the pre-trigger part of a sweep.
+ * While waiting for the trigger, the spans of every finished column are
+ * added here so the columns before the trigger can be drawn when it fires.
+ * An entry with lo > hi is an empty column.
+ */
+#define COLUMN_HISTORY       512  // Must be a power of 2
+#define COLUMN_HISTORY_MASK  (COLUMN_HISTORY - 1)
+
+typedef struct column_hist_s
+{
+    uint32_t head;                   // Number of columns added
+    uint16_t lo[COLUMN_HISTORY][2];  // Span of CH1 and CH2
+    uint16_t hi[COLUMN_HISTORY][2];
+} column_hist_t;
+
+static inline void column_hist_add(column_hist_t *h, const column_t *ch1, const column_t *ch2, uint8_t mode)
+{
+    uint32_t i = h->head & COLUMN_HISTORY_MASK;
+
+    if(!column_span(ch1, mode, &h->lo[i][0], &h->hi[i][0])) {
+        h->lo[i][0] = 1;
+        h->hi[i][0] = 0;
+    }
+    if(!column_span(ch2, mode, &h->lo[i][1], &h->hi[i][1])) {
+        h->lo[i][1] = 1;
+        h->hi[i][1] = 0;
+    }
+    h->head++;
+}
+
+/*
+ * Span of channel ch in the column 'back' columns ago (1 = the last column added).
+ * Returns false when the column is empty.
+ */
+static inline bool column_hist_get(const column_hist_t *h, uint32_t back, int ch, uint16_t *lo, uint16_t *hi)
+{
+    uint32_t i = (h->head - back) & COLUMN_HISTORY_MASK;
+
+    *lo = h->lo[i][ch];
+    *hi = h->hi[i][ch];
+    return *lo <= *hi;
+}
+
+#endif
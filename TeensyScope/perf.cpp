@@ -0,0 +1,71 @@
+/*
+ * perf.cpp - Cycle counter profiling
+ */
+
+#include "perf.h"
+
+#if PERF_ENABLE
+
+perf_stat_t perf_stats[PERF_SECTIONS];
+
+static const char *names[PERF_SECTIONS] = {"isr", "dma", "raster", "decay", "push", "cli"};
+
+/*
+ * Clear the statistics of all sections
+ */
+void perf_reset()
+{
+    noInterrupts();
+    for(int i=0; i<PERF_SECTIONS; i++) {
+        memset(&perf_stats[i], 0, sizeof(perf_stat_t));
+        perf_stats[i].min = 0xffffffff;
+    }
+    interrupts();
+}
+
+/*
+ * Print the statistics in cycles and us, followed by the non empty buckets
+ * of the histogram. The interrupt sections are copied with the interrupts
+ * disabled so they are consistent.
+ */
+void perf_print()
+{
+    const float cycles_us = F_CPU_ACTUAL / 1000000.0f;
+
+    Serial.println("section      count        min        max       mean   mean us");
+    for(int i=0; i<PERF_SECTIONS; i++) {
+        perf_stat_t s;
+        float mean;
+
+        noInterrupts();
+        s = perf_stats[i];
+        interrupts();
+        if(s.count == 0) {
+            Serial.printf("%-8s %9d          -          -          -         -\n", names[i], 0);
+            continue;
+        }
+        mean = (float)s.sum / s.count;
+        Serial.printf("%-8s %9u %10u %10u %10.1f %9.2f\n", names[i], (unsigned)s.count,
+                      (unsigned)s.min, (unsigned)s.max, mean, mean / cycles_us);
+        Serial.print("        ");
+        for(int b=0; b<PERF_BUCKETS; b++) {
+            if(s.hist[b]) {
+                Serial.printf(" %s2^%d:%u", (b == PERF_BUCKETS-1) ? ">=" : "", b, (unsigned)s.hist[b]);
+            }
+        }
+        Serial.println();
+    }
+}
+
+#else
+
+void perf_reset()
+{
+}
+
+void perf_print()
+{
+    Serial.println("Profiling is not enabled in this build (PERF_ENABLE in perf.h)");
+}
+
+#endif
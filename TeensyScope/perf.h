@@ -0,0 +1,73 @@
+/*
+ * perf.h - Cycle counter profiling
+ *
+ * PERF_BEGIN(id) and PERF_END(id) around a piece of code add the number of
+ * CPU cycles it took (from the DWT cycle counter) to the statistics of
+ * section id: count, min, max, sum and a histogram with a bucket per power of 2.
+ * The statistics are printed by the perf command.
+ *
+ * With PERF_ENABLE set to 0 the macros are empty and the sections cost
+ * nothing. A PERF_BEGIN and PERF_END pair must be in the same scope.
+ */
+
+#ifndef perf_h
+#define perf_h
+
+#include <Arduino.h>
+
+#ifndef PERF_ENABLE
+#define PERF_ENABLE   1
+#endif
+
+/*
+ * Sections
+ */
+#define PERF_ISR      0  // Timer sample interrupt
+#define PERF_DMA      1  // DMA block interrupt
+#define PERF_RASTER   2  // Rasterizer, per loop
+#define PERF_DECAY    3  // Phosphor decay pass
+#define PERF_PUSH     4  // LCD update, per loop
+#define PERF_CLI      5  // CLI command
+#define PERF_SECTIONS 6
+
+#define PERF_BUCKETS  24 // Bucket n counts 2^n .. 2^(n+1)-1 cycles, the last one also everything above
+
+typedef struct perf_stat_s
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[PERF_BUCKETS];
+} perf_stat_t;
+
+#if PERF_ENABLE
+
+extern perf_stat_t perf_stats[PERF_SECTIONS];
+
+#define PERF_BEGIN(id)  uint32_t perf_start_##id = ARM_DWT_CYCCNT
+#define PERF_END(id)    perf_add(&perf_stats[id], ARM_DWT_CYCCNT - perf_start_##id)
+
+static inline void perf_add(perf_stat_t *s, uint32_t cycles)
+{
+    uint32_t bucket = 31 - __builtin_clz(cycles | 1);
+
+    if(bucket >= PERF_BUCKETS) bucket = PERF_BUCKETS - 1;
+    if(cycles < s->min) s->min = cycles;
+    if(cycles > s->max) s->max = cycles;
+    s->sum += cycles;
+    s->count++;
+    s->hist[bucket]++;
+}
+
+#else
+
+#define PERF_BEGIN(id)
+#define PERF_END(id)
+
+#endif
+
+void perf_reset();
+void perf_print();
+
+#endif
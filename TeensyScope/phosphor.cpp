@@ -0,0 +1,187 @@
+/*
+ * phosphor.cpp - Decay kernels for the phosphor model of the XY display
+ */
+
+#include <string.h>
+#include "phosphor.h"
+
+#if defined(__ARM_FEATURE_SIMD32)
+#define PHOSPHOR_KERNEL "dsp"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PHOSPHOR_KERNEL "sse2"
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PHOSPHOR_KERNEL "neon"
+#else
+#define PHOSPHOR_KERNEL "scalar"
+#endif
+
+/*
+ * Scalar reference implementation
+ */
+uint8_t phosphor_decay_ref(uint8_t *line, int n, uint8_t max, uint16_t decay)
+{
+    uint8_t lit = 0;
+
+    for(int i=0; i<n; i++) {
+        uint8_t p = line[i];
+        lit |= p;
+        if(p > max) p = max;
+        line[i] = (p > decay) ? p - decay : 0;
+    }
+    return lit;
+}
+
+#if defined(__ARM_FEATURE_SIMD32)
+/*
+ * Clamp the 4 bytes of a to max.
+ * USUB8 sets the GE flags for each byte where a >= max,
+ * SEL then takes max for these bytes and a for the others.
+ */
+static inline uint32_t clamp8x4(uint32_t a, uint32_t max)
+{
+    uint32_t r;
+    asm("usub8 %0, %1, %2\n\t"
+        "sel   %0, %2, %1" : "=&r" (r) : "r" (a), "r" (max) : "cc");
+    return r;
+}
+
+// Saturating subtract of the 4 bytes
+static inline uint32_t uqsub8(uint32_t a, uint32_t b)
+{
+    uint32_t r;
+    asm("uqsub8 %0, %1, %2" : "=r" (r) : "r" (a), "r" (b));
+    return r;
+}
+
+uint8_t phosphor_decay(uint8_t *line, int n, uint8_t max, uint16_t decay)
+{
+    uint32_t *p = (uint32_t *)line;
+    uint32_t max4 = max * 0x01010101UL;
+    uint32_t decay4 = ((decay > 255) ? 255 : decay) * 0x01010101UL;
+    uint32_t lit = 0;
+    int i;
+
+    for(i=0; i<(n & ~7); i+=8) {
+        uint32_t a = p[0];
+        uint32_t b = p[1];
+        lit |= a | b;
+        p[0] = uqsub8(clamp8x4(a, max4), decay4);
+        p[1] = uqsub8(clamp8x4(b, max4), decay4);
+        p += 2;
+    }
+    lit |= lit >> 16;
+    lit |= lit >> 8;
+    return (lit | phosphor_decay_ref(&line[i], n - i, max, decay)) & 0xff;
+}
+
+#elif defined(__SSE2__)
+uint8_t phosphor_decay(uint8_t *line, int n, uint8_t max, uint16_t decay)
+{
+    __m128i vmax = _mm_set1_epi8(max);
+    __m128i vdecay = _mm_set1_epi8((decay > 255) ? 255 : decay);
+    __m128i lit = _mm_setzero_si128();
+    uint8_t lanes[16];
+    uint8_t r;
+    int i;
+
+    for(i=0; i<(n & ~15); i+=16) {
+        __m128i a = _mm_load_si128((__m128i *)&line[i]);
+        lit = _mm_or_si128(lit, a);
+        _mm_store_si128((__m128i *)&line[i], _mm_subs_epu8(_mm_min_epu8(a, vmax), vdecay));
+    }
+    _mm_storeu_si128((__m128i *)lanes, lit);
+    r = phosphor_decay_ref(&line[i], n - i, max, decay);
+    for(i=0; i<16; i++) r |= lanes[i];
+    return r;
+}
+
+#elif defined(__ARM_NEON)
+uint8_t phosphor_decay(uint8_t *line, int n, uint8_t max, uint16_t decay)
+{
+    uint8x16_t vmax = vdupq_n_u8(max);
+    uint8x16_t vdecay = vdupq_n_u8((decay > 255) ? 255 : decay);
+    uint8x16_t lit = vdupq_n_u8(0);
+    uint8_t lanes[16];
+    uint8_t r;
+    int i;
+
+    for(i=0; i<(n & ~15); i+=16) {
+        uint8x16_t a = vld1q_u8(&line[i]);
+        lit = vorrq_u8(lit, a);
+        vst1q_u8(&line[i], vqsubq_u8(vminq_u8(a, vmax), vdecay));
+    }
+    vst1q_u8(lanes, lit);
+    r = phosphor_decay_ref(&line[i], n - i, max, decay);
+    for(i=0; i<16; i++) r |= lanes[i];
+    return r;
+}
+
+#else
+uint8_t phosphor_decay(uint8_t *line, int n, uint8_t max, uint16_t decay)
+{
+    return phosphor_decay_ref(line, n, max, decay);
+}
+#endif
+
+/*
+ * Returns the amount to decay the pixels with for a decay pass at time now (in us)
+ */
+uint16_t phosphor_decay_step(phosphor_sched_t *sched, uint32_t now, uint16_t decay_val)
+{
+    uint32_t elapsed = now - sched->last;
+    uint64_t total;
+
+    sched->last = now;
+    if(elapsed > PHOSPHOR_MAX_ELAPSED) elapsed = PHOSPHOR_MAX_ELAPSED;
+
+    total = (uint64_t)decay_val * elapsed + sched->rest;
+    sched->rest = total % PHOSPHOR_DECAY_PERIOD;
+    total /= PHOSPHOR_DECAY_PERIOD;
+    return (total > 0xffff) ? 0xffff : total;
+}
+
+/*
+ * Returns the name of the kernel used by phosphor_decay()
+ */
+const char *phosphor_kernel()
+{
+    return PHOSPHOR_KERNEL;
+}
+
+/*
+ * Compare phosphor_decay() with the reference implementation.
+ * Lines with edge values and pseudo random values are decayed with
+ * a set of max and decay values, including line lengths that are not
+ * a multiple of the vector size.
+ * Returns the number of lines where the result differs.
+ */
+uint32_t phosphor_check()
+{
+    static const uint8_t max_vals[] = {0, 1, 127, 128, 240, 254, 255};
+    static const uint16_t decay_vals[] = {0, 1, 3, 127, 255, 256, 0xffff};
+    static const uint8_t edge_vals[] = {0, 1, 2, 3, 126, 127, 128, 129, 239, 240, 254, 255};
+    alignas(16) uint8_t line[101];
+    alignas(16) uint8_t ref[101];
+    uint32_t seed = 1;
+    uint32_t errors = 0;
+
+    for(unsigned m=0; m<sizeof(max_vals)/sizeof(max_vals[0]); m++) {
+        for(unsigned d=0; d<sizeof(decay_vals)/sizeof(decay_vals[0]); d++) {
+            for(int n=0; n<=101; n+=20) {
+                for(int i=0; i<101; i++) {
+                    seed = seed * 1103515245 + 12345;
+                    line[i] = (i & 1) ? edge_vals[(seed >> 16) % 12] : (seed >> 16);
+                    ref[i] = line[i];
+                }
+                uint8_t lit = phosphor_decay(line, n, max_vals[m], decay_vals[d]);
+                uint8_t ref_lit = phosphor_decay_ref(ref, n, max_vals[m], decay_vals[d]);
+                if((memcmp(line, ref, sizeof(line)) != 0) || ((lit != 0) != (ref_lit != 0))) {
+                    errors++;
+                }
+            }
+        }
+    }
+    return errors;
+}
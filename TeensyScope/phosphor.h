@@ -0,0 +1,63 @@
+/*
+ * phosphor.h - Decay kernels for the phosphor model of the XY display
+ *
+ * A decay step clamps every pixel of a line to the maximum intensity and
+ * then lowers it by the decay value, stopping at 0:
+ *     pixel = max(min(pixel, burn_max) - decay_val, 0)
+ *
+ * The pixels are 8 bits intensities.
+ * phosphor_decay() uses the fastest implementation for the target:
+ *  - Cortex-M7: DSP instructions (USUB8/SEL and UQSUB8), 4 pixels per instruction
+ *  - x86 host:  SSE2, 16 pixels per instruction
+ *  - ARM host:  NEON, 16 pixels per instruction
+ * phosphor_decay_ref() is the scalar reference implementation.
+ * Both return a non zero value when any pixel of the line was lit before the decay.
+ *
+ * The line must be 16 bytes aligned.
+ *
+ * The decay is not tied to the sample rate. The decay value is the amount
+ * by which a pixel fades in PHOSPHOR_DECAY_PERIOD microseconds and
+ * phosphor_decay_step() converts the time elapsed since the previous decay
+ * pass into the amount to subtract in the next pass. Parts of a step that
+ * are too small to apply are carried over to the next pass.
+ *
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef phosphor_h
+#define phosphor_h
+
+#include <stdint.h>
+
+#define PHOSPHOR_DECAY_PERIOD  8000     // us, time in which a pixel fades by the decay value
+#define PHOSPHOR_MAX_ELAPSED   1000000  // us, longer pauses are handled as this
+
+typedef struct phosphor_sched_s
+{
+    uint32_t last;  // Time of the previous decay pass in us
+    uint32_t rest;  // Part of the decay that has not been applied yet
+} phosphor_sched_t;
+
+uint16_t phosphor_decay_step(phosphor_sched_t *sched, uint32_t now, uint16_t decay_val);
+uint8_t  phosphor_decay(uint8_t *line, int n, uint8_t max, uint16_t decay);
+uint8_t  phosphor_decay_ref(uint8_t *line, int n, uint8_t max, uint16_t decay);
+uint32_t phosphor_check();
+const char *phosphor_kernel();
+
+/*
+ * Add inc to the intensity of a pixel, limited to max.
+ * Returns true when the sum went over max.
+ */
+static inline bool phosphor_burn(uint8_t *pixel, uint16_t inc, uint8_t max)
+{
+    uint32_t sum = *pixel + inc;
+
+    if(sum > max) {
+        *pixel = max;
+        return true;
+    }
+    *pixel = sum;
+    return false;
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * sample_ring.h - Lock free single producer / single consumer sample ring
+ *
+ * The sample interrupt (producer) pushes the raw ADC values and the
+ * trigger input into the ring and the rasterizer in loop() (consumer)
+ * takes them out in batches.
+ * Only the producer writes head and only the consumer writes tail so no
+ * locking is needed. When the ring is full the sample is dropped and
+ * counted as an overrun.
+ *
+ * This file does not depend on the Arduino environment so the ring can
+ * also be used on a host with a producer thread.
+ */
+
+#ifndef sample_ring_h
+#define sample_ring_h
+
+#include <stdint.h>
+#include <atomic>
+
+#define SAMPLE_RING_SIZE  4096  // Number of samples, must be a power of 2
+#define SAMPLE_RING_MASK  (SAMPLE_RING_SIZE - 1)
+
+/*
+ * The ADC values use at most 12 bits, the upper bits of ch1
+ * are used for the digital inputs.
+ */
+#define SAMPLE_VALUE      0x0fff
+#define SAMPLE_TRIGGER    0x8000  // Trigger input (ModeOP) is high
+
+typedef struct sample_s
+{
+    uint16_t ch1;
+    uint16_t ch2;
+} sample_t;
+
+typedef struct sample_ring_s
+{
+    std::atomic<uint32_t> head;      // Next position to write, producer only
+    std::atomic<uint32_t> tail;      // Next position to read, consumer only
+    std::atomic<uint32_t> overruns;  // Samples dropped because the ring was full
+    uint32_t max_fill;               // Highest fill level seen by the consumer
+    sample_t buf[SAMPLE_RING_SIZE];
+} sample_ring_t;
+
+/*
+ * Empty the ring and clear the statistics.
+ * Only call this when the producer is stopped.
+ */
+static inline void sample_ring_reset(sample_ring_t *r)
+{
+    r->head.store(0);
+    r->tail.store(0);
+    r->overruns.store(0);
+    r->max_fill = 0;
+}
+
+/*
+ * Producer side: add a sample.
+ * Returns false when the ring is full and the sample has been dropped.
+ */
+static inline bool sample_ring_push(sample_ring_t *r, sample_t s)
+{
+    uint32_t head = r->head.load(std::memory_order_relaxed);
+
+    if((head - r->tail.load(std::memory_order_acquire)) == SAMPLE_RING_SIZE) {
+        r->overruns.store(r->overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+    r->buf[head & SAMPLE_RING_MASK] = s;
+    r->head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+/*
+ * Consumer side: take up to max samples out of the ring.
+ * Returns the number of samples copied to out.
+ */
+static inline uint32_t sample_ring_pop(sample_ring_t *r, sample_t *out, uint32_t max)
+{
+    uint32_t tail = r->tail.load(std::memory_order_relaxed);
+    uint32_t count = r->head.load(std::memory_order_acquire) - tail;
+
+    if(count > r->max_fill) r->max_fill = count;
+    if(count > max) count = max;
+    for(uint32_t i=0; i<count; i++) {
+        out[i] = r->buf[(tail + i) & SAMPLE_RING_MASK];
+    }
+    r->tail.store(tail + count, std::memory_order_release);
+    return count;
+}
+
+#endif
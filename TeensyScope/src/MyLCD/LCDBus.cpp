@@ -0,0 +1,112 @@
+/*
+ * LCDBus.cpp - Port mapped 16 bits parallel bus for the LCD interface
+ */
+
+#include <string.h>
+#include "LCDBus.h"
+
+/*
+ * Build the lookup tables for the bus.
+ * pin_reg[i] is the GPIO DR register of data line DB_i and
+ * pin_mask[i] the bit of DB_i within this register.
+ * Data lines on the same DR register are grouped in one port so
+ * they can be written with a single set and clear store.
+ *
+ * Returns 0 when successful or -1 when the data lines are spread over more
+ * than LCD_BUS_PORTS GPIO ports.
+ */
+int lcd_bus_init(lcd_bus_t *bus, volatile uint32_t *const pin_reg[], const uint32_t pin_mask[])
+{
+    volatile uint32_t *port_reg[LCD_BUS_PORTS];
+    int p;
+
+    memset(bus, 0, sizeof(lcd_bus_t));
+
+    // Group the data lines per GPIO port
+    for(int i=0; i<LCD_BUS_PINS; i++) {
+        for(p=0; p<bus->num_ports; p++) {
+            if(port_reg[p] == pin_reg[i]) break;
+        }
+        if(p == bus->num_ports) {
+            if(bus->num_ports == LCD_BUS_PORTS) return -1;
+            port_reg[bus->num_ports++] = pin_reg[i];
+        }
+        bus->pin_port[i] = p;
+        bus->pin_mask[i] = pin_mask[i];
+        bus->port_mask[p] |= pin_mask[i];
+        if(i < 8) bus->port_mask_lo[p] |= pin_mask[i];
+    }
+
+    // Unused ports get empty masks on the first port
+    for(p=0; p<LCD_BUS_PORTS; p++) {
+        volatile uint32_t *reg = (p < bus->num_ports) ? port_reg[p] : port_reg[0];
+        bus->port_set[p]   = reg + LCD_BUS_DR_SET;
+        bus->port_clear[p] = reg + LCD_BUS_DR_CLEAR;
+    }
+
+    // Translate every possible byte value into port bits
+    for(int v=0; v<256; v++) {
+        for(int b=0; b<8; b++) {
+            if(v & (1 << b)) {
+                bus->lut_lo[bus->pin_port[b]][v]   |= bus->pin_mask[b];
+                bus->lut_hi[bus->pin_port[b+8]][v] |= bus->pin_mask[b+8];
+            }
+        }
+    }
+    return 0;
+}
+
+/*
+ * Translate a word into set and clear masks per port using the lookup tables.
+ * This is what lcd_bus_write() puts on the ports.
+ */
+void lcd_bus_encode(const lcd_bus_t *bus, uint16_t d, uint32_t set[], uint32_t clear[])
+{
+    for(int p=0; p<LCD_BUS_PORTS; p++) {
+        set[p]   = bus->lut_lo[p][d & 0xff] | bus->lut_hi[p][d >> 8];
+        clear[p] = bus->port_mask[p] ^ set[p];
+    }
+}
+
+/*
+ * Reference encoder, does the same one data line at a time
+ * in the same way as the original digitalWriteFast implementation.
+ */
+void lcd_bus_encode_ref(const lcd_bus_t *bus, uint16_t d, uint32_t set[], uint32_t clear[])
+{
+    for(int p=0; p<LCD_BUS_PORTS; p++) {
+        set[p]   = 0;
+        clear[p] = 0;
+    }
+    for(int i=0; i<LCD_BUS_PINS; i++) {
+        if(d & (1 << i)) {
+            set[bus->pin_port[i]] |= bus->pin_mask[i];
+        } else {
+            clear[bus->pin_port[i]] |= bus->pin_mask[i];
+        }
+    }
+}
+
+/*
+ * Compare the lookup table encoder with the reference encoder for all
+ * possible words.
+ * Returns the number of words that are not encoded correctly.
+ */
+uint32_t lcd_bus_verify(const lcd_bus_t *bus)
+{
+    uint32_t set[LCD_BUS_PORTS], clear[LCD_BUS_PORTS];
+    uint32_t ref_set[LCD_BUS_PORTS], ref_clear[LCD_BUS_PORTS];
+    uint32_t errors = 0;
+
+    for(uint32_t d=0; d<0x10000; d++) {
+        lcd_bus_encode(bus, d, set, clear);
+        lcd_bus_encode_ref(bus, d, ref_set, ref_clear);
+        for(int p=0; p<LCD_BUS_PORTS; p++) {
+            if((set[p] != ref_set[p]) || (clear[p] != ref_clear[p])) {
+                errors++;
+                break;
+            }
+        }
+    }
+    return errors;
+}
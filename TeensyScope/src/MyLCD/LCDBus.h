@@ -0,0 +1,76 @@
+/*
+ * LCDBus.h - Port mapped 16 bits parallel bus for the LCD interface
+ *
+ * The 16 data lines of the LCD are spread over several GPIO ports of the
+ * i.MX RT1062. Instead of setting every data line with its own digitalWriteFast
+ * call, a 16 bits word is translated into a set and a clear mask per GPIO port
+ * using lookup tables that are built once from the pin mapping.
+ * Writing a word then only takes two register stores per port.
+ *
+ * This file does not depend on the Arduino environment so the encoder can
+ * also be built and checked on a host system.
+ */
+
+#ifndef LCDBus_h
+#define LCDBus_h
+
+#include <stdint.h>
+
+#define LCD_BUS_PINS   16  // Number of data lines
+#define LCD_BUS_PORTS  4   // Max. number of GPIO ports the data lines are spread over
+
+/*
+ * Offsets (in 32 bits words) of the DR_SET and DR_CLEAR registers
+ * relative to the GPIO DR register
+ */
+#define LCD_BUS_DR_SET    (0x84/4)
+#define LCD_BUS_DR_CLEAR  (0x88/4)
+
+typedef struct lcd_bus_s
+{
+    volatile uint32_t *port_set[LCD_BUS_PORTS];
+    volatile uint32_t *port_clear[LCD_BUS_PORTS];
+    uint32_t port_mask[LCD_BUS_PORTS];     // All data lines on this port
+    uint32_t port_mask_lo[LCD_BUS_PORTS];  // Data lines DB_0..DB_7 on this port
+    uint32_t lut_lo[LCD_BUS_PORTS][256];   // Port bits for data bits 0..7
+    uint32_t lut_hi[LCD_BUS_PORTS][256];   // Port bits for data bits 8..15
+    uint8_t  pin_port[LCD_BUS_PINS];       // Port index of each data line
+    uint32_t pin_mask[LCD_BUS_PINS];       // Port bit of each data line
+    uint8_t  num_ports;
+} lcd_bus_t;
+
+int      lcd_bus_init(lcd_bus_t *bus, volatile uint32_t *const pin_reg[], const uint32_t pin_mask[]);
+void     lcd_bus_encode(const lcd_bus_t *bus, uint16_t d, uint32_t set[], uint32_t clear[]);
+void     lcd_bus_encode_ref(const lcd_bus_t *bus, uint16_t d, uint32_t set[], uint32_t clear[]);
+uint32_t lcd_bus_verify(const lcd_bus_t *bus);
+
+/*
+ * Put a 16 bits word on the data lines.
+ * Unused port entries point to the first port with empty masks so the loop
+ * has a fixed length and can be unrolled by the compiler.
+ */
+static inline void lcd_bus_write(const lcd_bus_t *bus, uint16_t d)
+{
+    uint8_t lo = d & 0xff;
+    uint8_t hi = d >> 8;
+
+    for(int p=0; p<LCD_BUS_PORTS; p++) {
+        uint32_t v = bus->lut_lo[p][lo] | bus->lut_hi[p][hi];
+        *bus->port_set[p]   = v;
+        *bus->port_clear[p] = bus->port_mask[p] ^ v;
+    }
+}
+
+/*
+ * Put 8 bits on data lines DB_0..DB_7, DB_8..DB_15 are not changed
+ */
+static inline void lcd_bus_write_lo(const lcd_bus_t *bus, uint8_t b)
+{
+    for(int p=0; p<LCD_BUS_PORTS; p++) {
+        uint32_t v = bus->lut_lo[p][b];
+        *bus->port_set[p]   = v;
+        *bus->port_clear[p] = bus->port_mask_lo[p] ^ v;
+    }
+}
+
+#endif
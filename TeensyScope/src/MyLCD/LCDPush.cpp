@@ -0,0 +1,146 @@
+/*
+ * LCDPush.cpp - Scanline based frame push engine
+ */
+
+#include "LCDPush.h"
+
+LCDPush::LCDPush(LCDTransport *t)
+{
+    transport = t;
+    active = false;
+    frame_count = 0;
+}
+
+/*
+ * Start pushing a new frame for the area x,y - x+sx-1,y+sy-1.
+ * The done function is called (from service()) when the last line
+ * has been sent.
+ * When a line mask is given, only the lines with their bit set
+ * (bit n%32 of line_mask[n/32]) are rendered and sent. The mask must not
+ * be changed while the frame is in flight.
+ * Returns false when a frame is still in flight or the area is too wide.
+ */
+bool LCDPush::begin(int ax, int ay, int asx, int asy, lcd_render_fn arender, void *actx,
+                    void (*adone)(void *ctx), const uint32_t *aline_mask)
+{
+    if(active || (asx > LCD_PUSH_MAX_WIDTH)) {
+        return false;
+    }
+    x = ax;
+    y = ay;
+    sx = asx;
+    sy = asy;
+    render = arender;
+    ctx = actx;
+    done = adone;
+    line_mask = aline_mask;
+
+    render_line = 0;
+    render_buf = 0;
+    send_buf = 0;
+    send_pos = 0;
+    release_buf = -1;
+    buf_lines[0] = 0;
+    buf_lines[1] = 0;
+
+    active = true;
+    transport->begin_write();
+    return true;
+}
+
+/*
+ * Progress the frame.
+ * Renders lines into a free buffer whenever possible and hands the
+ * next line to the transport when it is idle.
+ * At most max_lines lines are handed to the transport in one call and
+ * the function returns as soon as there is nothing to do but to wait
+ * for the transport.
+ * Returns true when no frame is in flight (anymore).
+ */
+bool LCDPush::service(int max_lines)
+{
+    int sent = 0;
+
+    while(active) {
+        bool idle = !transport->busy();
+
+        // The transport has finished the last line of a buffer, release it
+        if(idle && (release_buf >= 0)) {
+            buf_lines[release_buf] = 0;
+            release_buf = -1;
+        }
+
+        // Keep the renderer ahead of the transport
+        while((render_line < sy) && !line_needed(render_line)) {
+            render_line++;
+        }
+        if((render_line < sy) && (buf_lines[render_buf] == 0)) {
+            int n = 0;
+            while((n < LCD_PUSH_LINES) && (render_line < sy)) {
+                if(line_needed(render_line)) {
+                    render(render_line, sx, &buf[render_buf][n * sx], ctx);
+                    buf_line_no[render_buf][n++] = render_line;
+                }
+                render_line++;
+            }
+            buf_lines[render_buf] = n;
+            render_buf ^= 1;
+            continue;
+        }
+
+        if(!idle) {
+            break; // Nothing to do but waiting for the transport
+        }
+
+        if(buf_lines[send_buf] == 0) {
+            // Nothing left to render or send, frame complete
+            transport->end_write();
+            active = false;
+            frame_count++;
+            if(done) done(ctx);
+            break;
+        }
+
+        if(sent == max_lines) {
+            break;
+        }
+
+        transport->write_line(x, y + buf_line_no[send_buf][send_pos], sx, &buf[send_buf][send_pos * sx]);
+        sent++;
+        if(++send_pos == buf_lines[send_buf]) {
+            // Last line of this buffer is on its way
+            release_buf = send_buf;
+            send_buf ^= 1;
+            send_pos = 0;
+        }
+    }
+    return !active;
+}
+
+bool LCDPush::line_needed(int line)
+{
+    return !line_mask || (line_mask[line >> 5] & (1UL << (line & 31)));
+}
+
+bool LCDPush::busy()
+{
+    return active;
+}
+
+/*
+ * Stop the frame in flight without calling the done function.
+ * Waits for the transport to finish the current line.
+ */
+void LCDPush::abort()
+{
+    if(active) {
+        while(transport->busy());
+        transport->end_write();
+        active = false;
+    }
+}
+
+uint32_t LCDPush::frames()
+{
+    return frame_count;
+}
@@ -0,0 +1,79 @@
+/*
+ * LCDPush.h - Scanline based frame push engine
+ *
+ * A frame is pushed to the LCD a few scanlines at a time.
+ * Scanlines are rendered into one half of a ping-pong buffer while the
+ * transport sends the other half to the LCD. The engine is driven by
+ * calling service() from loop() so the CLI and the rest of the system keep
+ * running while a frame is in flight.
+ *
+ * An optional line mask selects the lines that have to be pushed,
+ * every line that is pushed gets its own window on the LCD.
+ *
+ * The renderer and the transport are separated so the engine can be used
+ * with any transport (CPU driven bus, DMA, or a mock transport on a host).
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef LCDPush_h
+#define LCDPush_h
+
+#include <stdint.h>
+
+#define LCD_PUSH_LINES      4    // Scanlines per buffer
+#define LCD_PUSH_MAX_WIDTH  480  // Max. scanline length in pixels
+
+/*
+ * Render scanline 'line' (0 = top line of the area) into buf.
+ * buf[0] is the rightmost pixel of the line, which is the order in which
+ * the LCD consumes the data in landscape orientation.
+ */
+typedef void (*lcd_render_fn)(int line, int len, uint16_t *buf, void *ctx);
+
+/*
+ * Interface of the transport that moves pixel data to the LCD.
+ * write_line() may return before the data has been sent, busy() must
+ * return true until the transport is done with the buffer.
+ */
+class LCDTransport
+{
+    public:
+        virtual void begin_write() = 0;
+        virtual void write_line(int x, int y, int len, const uint16_t *buf) = 0;
+        virtual bool busy() = 0;
+        virtual void end_write() = 0;
+};
+
+class LCDPush
+{
+    public:
+        LCDPush(LCDTransport *transport);
+        bool begin(int x, int y, int sx, int sy, lcd_render_fn render, void *ctx,
+                   void (*done)(void *ctx) = 0, const uint32_t *line_mask = 0);
+        bool service(int max_lines);
+        bool busy();
+        void abort();
+        uint32_t frames();
+
+    private:
+        LCDTransport *transport;
+        lcd_render_fn render;
+        void         *ctx;
+        void        (*done)(void *ctx);
+        int           x, y, sx, sy;
+        const uint32_t *line_mask;   // Bit set for each line to push, 0 = all lines
+        bool          active;
+        int           render_line;   // Next line to render
+        int           render_buf;    // Buffer to render into
+        int           send_buf;      // Buffer being sent
+        int           send_pos;      // Line within the buffer being sent
+        int           release_buf;   // Buffer to release when the transport is idle
+        int           buf_lines[2];  // Number of lines in each buffer, 0 = free
+        int           buf_line_no[2][LCD_PUSH_LINES]; // Line number of each line in a buffer
+        uint32_t      frame_count;
+        uint16_t      buf[2][LCD_PUSH_LINES * LCD_PUSH_MAX_WIDTH];
+
+        bool line_needed(int line);
+};
+
+#endif
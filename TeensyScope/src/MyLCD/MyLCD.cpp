@@ -4,8 +4,6 @@
 
 #include "MyLCD.h"
 
-#define DRAW_RETICLE // Undefine when no reticle should be drawn
-
 /*
  * I/O Pin definitions for the LCD interface
  * The LCD uses a 16 bits 8080 series parallel interface
@@ -15,7 +13,10 @@
  * These can be placed at any of the available I/O pins of
  * the Teensy 4.0 or 4.1
  * Please note that on a Teensy 4, only 4 I/O pins are left
- * 
+ *
+ * The data lines are written through the GPIO set/clear registers
+ * (see LCDBus.h) so the port and bit of each pin are looked up once
+ * at startup. Remapping a data line only requires changing its define.
  */
  
 #define DB_0_PIN  40
@@ -73,22 +74,23 @@ inline void pulse_WR()
 
 MyLCD::MyLCD()
 { 
-    pinMode(DB_0_PIN , OUTPUT);
-    pinMode(DB_1_PIN , OUTPUT);
-    pinMode(DB_2_PIN , OUTPUT);
-    pinMode(DB_3_PIN , OUTPUT);
-    pinMode(DB_4_PIN , OUTPUT);
-    pinMode(DB_5_PIN , OUTPUT);
-    pinMode(DB_6_PIN , OUTPUT);
-    pinMode(DB_7_PIN , OUTPUT);
-    pinMode(DB_8_PIN , OUTPUT);
-    pinMode(DB_9_PIN , OUTPUT);
-    pinMode(DB_10_PIN, OUTPUT);
-    pinMode(DB_11_PIN, OUTPUT);
-    pinMode(DB_12_PIN, OUTPUT);
-    pinMode(DB_13_PIN, OUTPUT);
-    pinMode(DB_14_PIN, OUTPUT);
-    pinMode(DB_15_PIN, OUTPUT);
+    static const uint8_t db_pins[LCD_BUS_PINS] = {
+        DB_0_PIN, DB_1_PIN, DB_2_PIN,  DB_3_PIN,  DB_4_PIN,  DB_5_PIN,  DB_6_PIN,  DB_7_PIN,
+        DB_8_PIN, DB_9_PIN, DB_10_PIN, DB_11_PIN, DB_12_PIN, DB_13_PIN, DB_14_PIN, DB_15_PIN
+    };
+    volatile uint32_t *pin_reg[LCD_BUS_PINS];
+    uint32_t pin_mask[LCD_BUS_PINS];
+
+    /*
+     * Get the GPIO port and bit of every data line from the Teensy core
+     * so the bus lookup tables always match the pin definitions above.
+     */
+    for(int i=0; i<LCD_BUS_PINS; i++) {
+        pinMode(db_pins[i], OUTPUT);
+        pin_reg[i]  = digital_pin_to_info_PGM[db_pins[i]].reg;
+        pin_mask[i] = digital_pin_to_info_PGM[db_pins[i]].mask;
+    }
+    bus_error = lcd_bus_init(&bus, pin_reg, pin_mask) != 0;
     
     pinMode(RS_PIN,OUTPUT);
     pinMode(WR_PIN,OUTPUT);
@@ -97,6 +99,16 @@ MyLCD::MyLCD()
 
 }
 
+/*
+ * Check the port mapped bus against the per pin reference encoding.
+ * Returns the number of data words that would not be written correctly.
+ */
+uint32_t MyLCD::check_bus()
+{
+    if(bus_error) return 0x10000;
+    return lcd_bus_verify(&bus);
+}
+
 /*
  * Writes a command to the LCD
  * The register select pin is set low in order to
@@ -107,14 +119,7 @@ MyLCD::MyLCD()
 void MyLCD::write_command(uint8_t cmd)  
 {   
     digitalWriteFast(RS_PIN, LOW);
-    digitalWriteFast(DB_0_PIN , cmd & 0x01);
-    digitalWriteFast(DB_1_PIN , cmd & 0x02);
-    digitalWriteFast(DB_2_PIN , cmd & 0x04);
-    digitalWriteFast(DB_3_PIN , cmd & 0x08);
-    digitalWriteFast(DB_4_PIN , cmd & 0x10);
-    digitalWriteFast(DB_5_PIN , cmd & 0x20);
-    digitalWriteFast(DB_6_PIN , cmd & 0x40);
-    digitalWriteFast(DB_7_PIN , cmd & 0x80);
+    lcd_bus_write_lo(&bus, cmd);
     pulse_WR();
     digitalWriteFast(RS_PIN, HIGH);
 }
@@ -124,24 +129,7 @@ void MyLCD::write_command(uint8_t cmd)
  */
 void MyLCD::write_word(uint16_t d)
 {
-    digitalWriteFast(DB_0_PIN , d & 0x01);
-    digitalWriteFast(DB_1_PIN , d & 0x02);
-    digitalWriteFast(DB_2_PIN , d & 0x04);
-    digitalWriteFast(DB_3_PIN , d & 0x08);
-    digitalWriteFast(DB_4_PIN , d & 0x10);
-    digitalWriteFast(DB_5_PIN , d & 0x20);
-    digitalWriteFast(DB_6_PIN , d & 0x40);
-    digitalWriteFast(DB_7_PIN , d & 0x80);
-    d >>=8;
-    digitalWriteFast(DB_8_PIN , d & 0x01);
-    digitalWriteFast(DB_9_PIN , d & 0x02);
-    digitalWriteFast(DB_10_PIN, d & 0x04);
-    digitalWriteFast(DB_11_PIN, d & 0x08);
-    digitalWriteFast(DB_12_PIN, d & 0x10);
-    digitalWriteFast(DB_13_PIN, d & 0x20);
-    digitalWriteFast(DB_14_PIN, d & 0x40);
-    digitalWriteFast(DB_15_PIN, d & 0x80);
-    
+    lcd_bus_write(&bus, d);
     pulse_WR();
 }
 
@@ -150,15 +138,7 @@ void MyLCD::write_word(uint16_t d)
  */
 void MyLCD::write_byte(uint8_t b)
 {
-    digitalWriteFast(DB_0_PIN , b & 0x01);
-    digitalWriteFast(DB_1_PIN , b & 0x02);
-    digitalWriteFast(DB_2_PIN , b & 0x04);
-    digitalWriteFast(DB_3_PIN , b & 0x08);
-    digitalWriteFast(DB_4_PIN , b & 0x10);
-    digitalWriteFast(DB_5_PIN , b & 0x20);
-    digitalWriteFast(DB_6_PIN , b & 0x40);
-    digitalWriteFast(DB_7_PIN , b & 0x80);
-    
+    lcd_bus_write_lo(&bus, b);
     pulse_WR();
 }
 
@@ -171,23 +151,7 @@ void MyLCD::write_byte(uint8_t b)
  */
 void MyLCD::fast_fill(uint16_t d, long pix)
 {
-    digitalWriteFast(DB_0_PIN , d & 0x01);
-    digitalWriteFast(DB_1_PIN , d & 0x02);
-    digitalWriteFast(DB_2_PIN , d & 0x04);
-    digitalWriteFast(DB_3_PIN , d & 0x08);
-    digitalWriteFast(DB_4_PIN , d & 0x10);
-    digitalWriteFast(DB_5_PIN , d & 0x20);
-    digitalWriteFast(DB_6_PIN , d & 0x40);
-    digitalWriteFast(DB_7_PIN , d & 0x80);
-    d >>= 8;
-    digitalWriteFast(DB_8_PIN , d & 0x01);
-    digitalWriteFast(DB_9_PIN , d & 0x02); 
-    digitalWriteFast(DB_10_PIN, d & 0x04);
-    digitalWriteFast(DB_11_PIN, d & 0x08);
-    digitalWriteFast(DB_12_PIN, d & 0x10);
-    digitalWriteFast(DB_13_PIN, d & 0x20);
-    digitalWriteFast(DB_14_PIN, d & 0x40);
-    digitalWriteFast(DB_15_PIN, d & 0x80);
+    lcd_bus_write(&bus, d);
 
     for(int i=0; i<pix; i++) {
         pulse_WR(); delayNanoseconds(5);
@@ -827,64 +791,77 @@ uint8_t MyLCD::getFontYsize()
     return cfont.y_size;
 }
 
+/*
+ * LCDTransport interface, used by the LCDPush engine.
+ * The data is written by the CPU so write_line() returns when the
+ * line has been sent and the transport is never busy.
+ */
+void MyLCD::begin_write()
+{
+    digitalWriteFast(CS_PIN, LOW);
+}
+
+void MyLCD::write_line(int x, int y, int len, const uint16_t *buf)
+{
+    set_display_area(x, y, x+len-1, y);
+    for(int i=0; i<len; i++) {
+        write_word(buf[i]);
+    }
+}
+
+bool MyLCD::busy()
+{
+    return false;
+}
+
+void MyLCD::end_write()
+{
+    digitalWriteFast(CS_PIN, HIGH);
+}
+
 /*
  * draw_xy_scope is a modified version of drawBitmap.
- * Instead of drawing a standard 16 bits bitmap, this interprets the XY matrix with intensities
- * for the XY display
+ * Instead of drawing a standard 16 bits bitmap, this interprets the XY matrix with 8 bits intensities
+ * for the XY display and shows them in the colors of the palette.
+ * In landscape mode, only the lines marked in the dirty bitmap are drawn
+ * when a bitmap is given (bit n%32 of dirty[n/32] for line n from the top).
+ * The reticle is drawn where there is no data (landscape mode only).
  */
-void MyLCD::draw_xy_scope(int x, int y, int sx, int sy, uint16_t *data)
+void MyLCD::draw_xy_scope(int x, int y, int sx, int sy, const uint8_t *data, const palette_t *palette,
+                          const uint32_t *dirty, const reticle_t *reticle)
 {
-    unsigned int col;
-    int tx, ty, tc;
+    int tc;
 
     if (orient==PORTRAIT) {
         digitalWriteFast(CS_PIN, LOW);
         set_display_area(x, y, x+sx-1, y+sy-1);
         for (tc=0; tc<(sx*sy); tc++) {
-            col=pgm_read_word(&data[tc]);
-            write_word(col);
+            write_word(palette->rgb[data[tc]]);
         }
         digitalWriteFast(CS_PIN, HIGH);
     } else {
-        digitalWriteFast(CS_PIN, LOW);
-        for (ty=0; ty<sy; ty++) {
-            set_display_area(x, y+sy-ty-1, x+sx-1, y+sy-ty-1);
-            for (tx=sx-1; tx>=0; tx--) {
-                //col=pgm_read_word(&data[(ty*sx)+tx]);
-                col=pgm_read_word(&data[(tx*sy)+ty]);
-                // (r & 0b11111000) << 8 | (g & 0b11111100) << 3 | (b & 0b11111000) >> 3;
-                if(col > 255) col = 255;
-                col = (col & 0b11111000) << 8 | (col & 0b11111100) << 3;
-                /*
-                 * Check and draw reticle
-                 * only when no data at this point
-                 */
-#ifdef DRAW_RETICLE
-                if(col == 0) {
-                    // Check for reticle to be drawn
-                    if(((tx+1)%(sx/10) == 0) && ((ty+1)%(sy/40) == 0)) col=0xffff;
-                    else if(((tx+1)%(sx/50) == 0) && ((ty+1)%(sy/8) == 0)) col=0xffff;
-                    else if((tx == 0) || (tx == (sx-1)) || (ty == 0) || (ty == (sy-1))) col=0xffff;
-                    else if(((tx >= (sx/2-3))&&(tx <= (sx/2+1))) && ((ty+1)%(sy/40) == 0)) col = 0xffff;
-                    else if(((ty >= (sy/2-3))&&(ty <= (sy/2+1))) && ((tx+1)%(sx/50) == 0)) col = 0xffff;
-                }
-#endif
-                write_word(col);
-            }
+        uint16_t line[DISPLAY_ROWS];
+        scope_xy_image_t image = {data, sx, sy, reticle, palette};
+
+        begin_write();
+        for (int ty=0; ty<sy; ty++) {
+            if(dirty && !(dirty[ty >> 5] & (1UL << (ty & 31)))) continue;
+            scope_render_xy_line(ty, sx, line, &image);
+            write_line(x, y+ty, sx, line);
         }
-        digitalWriteFast(CS_PIN, HIGH);
+        end_write();
     }
 }
 
 /*
- * draw_xy_scope is a modified version of drawBitmap.
- * Instead of drawing a standard 16 bits bitmap, this interprets the XY matrix with intensities
- * for the XY display
+ * draw_scope is the time based version of draw_xy_scope.
+ * The matrix contains RGB565 colors instead of intensities.
+ * The reticle is drawn where there is no data (landscape mode only).
  */
-void MyLCD::draw_scope(int x, int y, int sx, int sy, uint16_t *data)
+void MyLCD::draw_scope(int x, int y, int sx, int sy, uint16_t *data, const reticle_t *reticle)
 {
     uint16_t col;
-    int tx, ty, tc;
+    int tc;
 
     if (orient==PORTRAIT) {
         digitalWriteFast(CS_PIN, LOW);
@@ -895,29 +872,106 @@ void MyLCD::draw_scope(int x, int y, int sx, int sy, uint16_t *data)
         }
         digitalWriteFast(CS_PIN, HIGH);
     } else {
-        digitalWriteFast(CS_PIN, LOW);
-        for (ty=0; ty<sy; ty++) {
-            set_display_area(x, y+sy-ty-1, x+sx-1, y+sy-ty-1);
-            for (tx=sx-1; tx>=0; tx--) {
-                //col=pgm_read_word(&data[(ty*sx)+tx]);
-                col=pgm_read_word(&data[(tx*sy)+ty]);
-                /*
-                 * Check and draw reticle
-                 * only when no data at this point
-                 */
-#ifdef DRAW_RETICLE
-                if(col == 0) {
-                    // Check for reticle to be drawn
-                    if(((tx+1)%(sx/10) == 0) && ((ty+1)%(sy/40) == 0)) col=0xffff;
-                    else if(((tx+1)%(sx/50) == 0) && ((ty+1)%(sy/8) == 0)) col=0xffff;
-                    else if((tx == 0) || (tx == (sx-1)) || (ty == 0) || (ty == (sy-1))) col=0xffff;
-                    else if(((tx >= (sx/2-3))&&(tx <= (sx/2+1))) && ((ty+1)%(sy/40) == 0)) col = 0xffff;
-                    else if(((ty >= (sy/2-3))&&(ty <= (sy/2+1))) && ((tx+1)%(sx/50) == 0)) col = 0xffff;
-                }
-#endif
-                write_word(col);
-            }
+        uint16_t line[DISPLAY_ROWS];
+        scope_image_t image = {data, sx, sy, reticle};
+
+        begin_write();
+        for (int ty=0; ty<sy; ty++) {
+            scope_render_time_line(ty, sx, line, &image);
+            write_line(x, y+ty, sx, line);
         }
-        digitalWriteFast(CS_PIN, HIGH);
+        end_write();
     }
 }
+
+/*
+ * draw_scope for the column based traces of the time based display.
+ * The traces and the reticle are rasterized while writing to the LCD.
+ */
+void MyLCD::draw_scope(int x, int y, const scope_trace_t *trace)
+{
+    uint16_t line[DISPLAY_ROWS];
+
+    begin_write();
+    for (int ty=0; ty<trace->sy; ty++) {
+        scope_render_trace_line(ty, trace->sx, line, (void *)trace);
+        write_line(x, y+ty, trace->sx, line);
+    }
+    end_write();
+}
+
+/*
+ * Draw a single column of the traces (col = 0 is the leftmost column).
+ * This is one window write of trace->sy pixels.
+ */
+void MyLCD::draw_scope_column(int x, int y, const scope_trace_t *trace, int col)
+{
+    uint16_t column[DISPLAY_COLUMNS];
+
+    scope_render_trace_column(col, trace->sy, column, trace);
+    begin_write();
+    write_column(x+col, y, trace->sy, column);
+    end_write();
+}
+
+/*
+ * Write a column of pixels from top to bottom, the counterpart of write_line().
+ * In landscape orientation a column is one line of the LCD.
+ */
+void MyLCD::write_column(int x, int y, int len, const uint16_t *buf)
+{
+    set_display_area(x, y, x, y+len-1);
+    for(int i=0; i<len; i++) {
+        write_word(buf[i]);
+    }
+}
+
+/*
+ * Hardware scrolling (landscape orientation only)
+ *
+ * The vertical scroll of the ILI948x moves the lines of the LCD, which
+ * are the columns in landscape orientation. scroll_area() selects the
+ * columns x .. x+sx-1 as the scroll area, the rest of the display stays
+ * where it is. scroll_to() shows column x of the display memory at the
+ * right edge of the scroll area, the columns to the left of it in memory
+ * (wrapping around in the scroll area) follow to the left of it on the display.
+ * So writing columns at increasing positions and scrolling to each new
+ * column makes the image roll from right to left.
+ */
+void MyLCD::scroll_area(int x, int sx)
+{
+    int tfa = DISPLAY_ROWS - x - sx;  // LCD lines above the scroll area
+
+    digitalWriteFast(CS_PIN, LOW);
+    write_command(0x33);   // Vertical Scrolling Definition
+    write_word(tfa>>8);    //   Top fixed area
+    write_word(tfa);
+    write_word(sx>>8);     //   Vertical scrolling area
+    write_word(sx);
+    write_word(x>>8);      //   Bottom fixed area
+    write_word(x);
+    digitalWriteFast(CS_PIN, HIGH);
+    scroll_to(x+sx-1);     // No scroll offset
+}
+
+void MyLCD::scroll_to(int x)
+{
+    int vsp = DISPLAY_ROWS - 1 - x;
+
+    digitalWriteFast(CS_PIN, LOW);
+    write_command(0x37);   // Vertical Scrolling Start Address
+    write_word(vsp>>8);
+    write_word(vsp);
+    digitalWriteFast(CS_PIN, HIGH);
+}
+
+/*
+ * Stop scrolling, the display memory is shown as is again
+ */
+void MyLCD::scroll_off()
+{
+    scroll_area(0, DISPLAY_ROWS);
+    digitalWriteFast(CS_PIN, LOW);
+    write_command(0x13);   // Normal Display Mode ON
+    digitalWriteFast(CS_PIN, HIGH);
+}
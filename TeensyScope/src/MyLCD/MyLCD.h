@@ -42,6 +42,9 @@
 //#define ILI9486     // 3.5"480x320 TFTLCD Shield for Arduino Mega2560
 
 #include "Arduino.h"
+#include "LCDBus.h"
+#include "LCDPush.h"
+#include "ScopeRender.h"
 
 struct _current_font
 {
@@ -54,7 +57,7 @@ struct _current_font
 
 
 
-class MyLCD
+class MyLCD : public LCDTransport
 {
     public:
       	MyLCD();
@@ -84,13 +87,26 @@ class MyLCD
       	uint8_t* getFont();
       	uint8_t	getFontXsize();
       	uint8_t	getFontYsize();
-      	void	draw_xy_scope(int x, int y, int sx, int sy, uint16_t *data);
-        void	draw_scope(int x, int y, int sx, int sy, uint16_t *data);
+      	void	draw_xy_scope(int x, int y, int sx, int sy, const uint8_t *data, const palette_t *palette, const uint32_t *dirty=0, const reticle_t *reticle=0);
+        void	draw_scope(int x, int y, int sx, int sy, uint16_t *data, const reticle_t *reticle=0);
+        void	draw_scope(int x, int y, const scope_trace_t *trace);
+        void	draw_scope_column(int x, int y, const scope_trace_t *trace, int col);
+        void	scroll_area(int x, int sx);
+        void	scroll_to(int x);
+        void	scroll_off();
       	void	lcdOff();
       	void	lcdOn();
       	void	setContrast(char c);
       	int		getDisplayXSize();
       	int		getDisplayYSize();
+      	uint32_t	check_bus();
+
+      	// LCDTransport interface
+      	void	begin_write();
+      	void	write_line(int x, int y, int len, const uint16_t *buf);
+      	bool	busy();
+      	void	end_write();
+      	void	write_column(int x, int y, int len, const uint16_t *buf);
 
 /*
 	The functions and variables below should not normally be used.
@@ -111,6 +127,8 @@ class MyLCD
         byte			orient;
         _current_font	cfont;
         boolean			_transparent;
+        lcd_bus_t		bus;
+        boolean			bus_error;
         
         void write_command(uint8_t VL);
         void write_word(uint16_t d);
@@ -0,0 +1,80 @@
+/*
+ * Palette.cpp - Intensity to RGB565 palettes for the XY display
+ */
+
+#include "Palette.h"
+
+/*
+ * A palette is defined by a few colors at increasing intensities,
+ * the colors in between are interpolated. The first point is always
+ * black at intensity 0 and the last one is at intensity 255.
+ */
+typedef struct palette_point_s
+{
+    uint8_t i, r, g, b;
+} palette_point_t;
+
+#define PALETTE_POINTS 5
+
+static const palette_point_t palettes[PALETTE_STYLES][PALETTE_POINTS] = {
+    // CLASSIC: r = g = intensity
+    {{0, 0, 0, 0}, {255, 255, 255, 0}},
+    // P31: green, the core of a bright spot turns whitish
+    {{0, 0, 0, 0}, {192, 24, 224, 40}, {255, 160, 255, 170}},
+    // P7: blue with a white core
+    {{0, 0, 0, 0}, {128, 0, 64, 200}, {255, 210, 230, 255}},
+    // AMBER
+    {{0, 0, 0, 0}, {255, 255, 176, 0}},
+    // HEAT
+    {{0, 0, 0, 0}, {64, 0, 0, 192}, {128, 200, 0, 128}, {192, 255, 176, 0}, {255, 255, 255, 255}}
+};
+
+static const char *palette_names[PALETTE_STYLES] = {
+    "classic", "p31", "p7", "amber", "heat"
+};
+
+/*
+ * Interpolate between two points of a palette
+ */
+static inline uint8_t lerp(uint8_t a, uint8_t b, int num, int den)
+{
+    return a + ((b - a) * num) / den;
+}
+
+/*
+ * Build the palette with the given style and persistence.
+ * Intensity i is shown as the color of intensity i*255/(255-persist),
+ * limited to 255.
+ */
+void palette_build(palette_t *p, uint8_t style, uint8_t persist)
+{
+    const palette_point_t *pt;
+
+    if(style >= PALETTE_STYLES) style = PALETTE_CLASSIC;
+    if(persist > PALETTE_MAX_PERSIST) persist = PALETTE_MAX_PERSIST;
+    p->style = style;
+    p->persist = persist;
+    pt = palettes[style];
+
+    for(int i=0; i<256; i++) {
+        int j = (i * 255) / (255 - persist);
+        int k = 1;
+        uint8_t r, g, b;
+
+        if(j > 255) j = 255;
+        while(pt[k].i < j) k++;
+        r = lerp(pt[k-1].r, pt[k].r, j - pt[k-1].i, pt[k].i - pt[k-1].i);
+        g = lerp(pt[k-1].g, pt[k].g, j - pt[k-1].i, pt[k].i - pt[k-1].i);
+        b = lerp(pt[k-1].b, pt[k].b, j - pt[k-1].i, pt[k].i - pt[k-1].i);
+        // (r & 0b11111000) << 8 | (g & 0b11111100) << 3 | (b & 0b11111000) >> 3;
+        p->rgb[i] = (r & 0b11111000) << 8 | (g & 0b11111100) << 3 | (b & 0b11111000) >> 3;
+    }
+}
+
+/*
+ * Returns the CLI name of a palette style
+ */
+const char *palette_name(uint8_t style)
+{
+    return (style < PALETTE_STYLES) ? palette_names[style] : "?";
+}
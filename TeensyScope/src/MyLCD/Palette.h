@@ -0,0 +1,46 @@
+/*
+ * Palette.h - Intensity to RGB565 palettes for the XY display
+ *
+ * The XY image holds an 8 bits intensity per pixel. The palette maps each
+ * intensity to the color of the phosphor, so the renderer only needs one
+ * table lookup per pixel.
+ *
+ * Persistence moves the knee of the palette: the top 'persist' intensity
+ * levels are all shown at full brightness, so a pixel stays bright longer
+ * before it visibly fades.
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef Palette_h
+#define Palette_h
+
+#include <stdint.h>
+
+/*
+ * Palette styles
+ *  CLASSIC - Yellow, the original TeensyScope colors
+ *  P31     - Green phosphor of most analog scopes
+ *  P7      - Blue-white phosphor with a long afterglow
+ *  AMBER   - Amber monochrome
+ *  HEAT    - False colors from blue via red and yellow to white
+ */
+#define PALETTE_CLASSIC  0
+#define PALETTE_P31      1
+#define PALETTE_P7       2
+#define PALETTE_AMBER    3
+#define PALETTE_HEAT     4
+#define PALETTE_STYLES   5
+
+#define PALETTE_MAX_PERSIST  240
+
+typedef struct palette_s
+{
+    uint8_t  style;
+    uint8_t  persist;
+    uint16_t rgb[256];  // RGB565 color for each intensity, rgb[0] is black
+} palette_t;
+
+void palette_build(palette_t *p, uint8_t style, uint8_t persist);
+const char *palette_name(uint8_t style);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * Reticle.cpp - Precomputed reticle (graticule) for the scope display
+ */
+
+#include <string.h>
+#include "Reticle.h"
+#include "ScopeRender.h"
+
+/*
+ * Build the reticle for an image of sx by sy pixels with xdiv horizontal
+ * and ydiv vertical divisions, each divided in subdiv parts.
+ */
+void reticle_build(reticle_t *r, int sx, int sy, int xdiv, int ydiv, int subdiv, uint8_t style)
+{
+    int xstep = sx / xdiv;            // Pixels per division
+    int ystep = sy / ydiv;
+    int xsub  = sx / (xdiv * subdiv); // Pixels per subdivision
+    int ysub  = sy / (ydiv * subdiv);
+
+    if(sx > RETICLE_MAX_WIDTH)  sx = RETICLE_MAX_WIDTH;
+    if(sy > RETICLE_MAX_HEIGHT) sy = RETICLE_MAX_HEIGHT;
+    r->sx = sx;
+    r->sy = sy;
+    r->style = style;
+    memset(r->bits, 0, sizeof(r->bits));
+
+    if(style == RETICLE_OFF) {
+        return;
+    }
+
+    for(int ty=0; ty<sy; ty++) {
+        for(int tx=0; tx<sx; tx++) {
+            bool dot;
+            bool xdiv_line  = ((tx+1) % xstep == 0);
+            bool ydiv_line  = ((ty+1) % ystep == 0);
+            bool xsub_point = ((tx+1) % xsub == 0);
+            bool ysub_point = ((ty+1) % ysub == 0);
+
+            if(style == RETICLE_CROSS) {
+                // Only the division lines through the center
+                xdiv_line = (tx+1 == sx/2);
+                ydiv_line = (ty+1 == sy/2);
+            }
+
+            dot  = xdiv_line && ysub_point;      // Vertical division lines
+            dot |= xsub_point && ydiv_line;      // Horizontal division lines
+            dot |= (tx == 0) || (tx == (sx-1)) || (ty == 0) || (ty == (sy-1)); // Border
+            dot |= (tx >= (sx/2-3)) && (tx <= (sx/2+1)) && ysub_point; // Ticks on the vertical center line
+            dot |= (ty >= (sy/2-3)) && (ty <= (sy/2+1)) && xsub_point; // Ticks on the horizontal center line
+
+            if(dot) {
+                int i = scope_index(tx, ty, sx, sy);
+                r->bits[i / sx][(i % sx) >> 5] |= 1UL << ((i % sx) & 31);
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+/*
+ * Reticle.h - Precomputed reticle (graticule) for the scope display
+ *
+ * The reticle is built once into a bitmap for the size and division
+ * settings of the display so the renderers only need to test one bit
+ * per pixel. The bitmap uses the same LCD order as the scope image. Building a new reticle is only needed when the style
+ * is changed.
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef Reticle_h
+#define Reticle_h
+
+#include <stdint.h>
+
+#define RETICLE_MAX_WIDTH   480
+#define RETICLE_MAX_HEIGHT  320
+#define RETICLE_WORDS       ((RETICLE_MAX_WIDTH+31)/32)
+
+/*
+ * Reticle styles
+ *  OFF   - No reticle
+ *  FULL  - Border, all divisions with subdivision dots and center ticks
+ *  CROSS - Border and the center axes with subdivision ticks only
+ */
+#define RETICLE_OFF    0
+#define RETICLE_FULL   1
+#define RETICLE_CROSS  2
+
+typedef struct reticle_s
+{
+    int      sx, sy;
+    uint8_t  style;
+    uint32_t bits[RETICLE_MAX_HEIGHT][RETICLE_WORDS]; // In LCD order, see scope_index()
+} reticle_t;
+
+void reticle_build(reticle_t *r, int sx, int sy, int xdiv, int ydiv, int subdiv, uint8_t style);
+
+/*
+ * Returns the bitmap row for line 'line' of the image (0 = top line)
+ */
+static inline const uint32_t *reticle_row(const reticle_t *r, int line)
+{
+    return r->bits[line];
+}
+
+/*
+ * Check the reticle at position i of a line (0 = rightmost pixel)
+ */
+static inline bool reticle_at(const uint32_t *row, int i)
+{
+    return (row[i >> 5] >> (i & 31)) & 1;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * ScopeRender.cpp - Scanline renderers for the scope display
+ */
+
+#include "ScopeRender.h"
+
+static const uint32_t no_reticle[RETICLE_WORDS] = {0};
+
+/*
+ * Returns the reticle bitmap row for a line of the image
+ */
+static inline const uint32_t *reticle_line(const scope_image_t *img, int line)
+{
+    return img->reticle ? reticle_row(img->reticle, line) : no_reticle;
+}
+
+/*
+ * Render a line of the XY display.
+ * The image contains intensities which are shown in the colors of the palette.
+ */
+void scope_render_xy_line(int line, int len, uint16_t *buf, void *image)
+{
+    const scope_xy_image_t *img = (const scope_xy_image_t *)image;
+    const uint8_t *data = &img->data[line * img->sx];
+    const uint16_t *rgb = img->palette->rgb;
+    const uint32_t *grid = img->reticle ? reticle_row(img->reticle, line) : no_reticle;
+    uint16_t col;
+
+    for (int i=0; i<len; i++) {
+        col = rgb[data[i]];
+        // Draw the reticle only when no data at this point
+        if((col == 0) && reticle_at(grid, i)) col = 0xffff;
+        *buf++ = col;
+    }
+}
+
+/*
+ * Render a line of the time based display.
+ * The image contains RGB565 colors.
+ */
+void scope_render_time_line(int line, int len, uint16_t *buf, void *image)
+{
+    const scope_image_t *img = (const scope_image_t *)image;
+    const uint16_t *data = &img->data[line * img->sx];
+    const uint32_t *grid = reticle_line(img, line);
+    uint16_t col;
+
+    for (int i=0; i<len; i++) {
+        col = data[i];
+        if((col == 0) && reticle_at(grid, i)) col = 0xffff;
+        *buf++ = col;
+    }
+}
+
+/*
+ * Empty all columns of the traces
+ */
+void scope_trace_clear(scope_trace_t *tr)
+{
+    for (int t=0; t<SCOPE_TRACES; t++) {
+        for (int i=0; i<SCOPE_TRACE_WIDTH; i++) {
+            tr->col[t][i].lo = 0xffff;
+            tr->col[t][i].hi = 0;
+        }
+    }
+}
+
+/*
+ * Empty column x of all traces (0 = leftmost column)
+ */
+void scope_trace_clear_column(scope_trace_t *tr, int x)
+{
+    for (int t=0; t<SCOPE_TRACES; t++) {
+        tr->col[t][tr->sx - 1 - x].lo = 0xffff;
+        tr->col[t][tr->sx - 1 - x].hi = 0;
+    }
+}
+
+/*
+ * Render a line of the time based display from the trace columns.
+ * A later trace is drawn on top of an earlier one.
+ */
+void scope_render_trace_line(int line, int len, uint16_t *buf, void *trace)
+{
+    const scope_trace_t *tr = (const scope_trace_t *)trace;
+    const uint32_t *grid = tr->reticle ? reticle_row(tr->reticle, line) : no_reticle;
+    uint16_t col;
+
+    for (int i=0; i<len; i++) {
+        col = 0;
+        for (int t=0; t<SCOPE_TRACES; t++) {
+            const scope_span_t *span = &tr->col[t][i];
+
+            if((line >= span->lo) && (line <= span->hi)) col = tr->color[t];
+        }
+        if((col == 0) && reticle_at(grid, i)) col = 0xffff;
+        *buf++ = col;
+    }
+}
+
+/*
+ * Render column col (0 = leftmost) of the time based display from top to bottom
+ */
+void scope_render_trace_column(int col, int len, uint16_t *buf, const scope_trace_t *tr)
+{
+    int i = tr->sx - 1 - col;  // Position in the LCD ordered columns and reticle rows
+    uint16_t c;
+
+    for (int line=0; line<len; line++) {
+        c = 0;
+        for (int t=0; t<SCOPE_TRACES; t++) {
+            const scope_span_t *span = &tr->col[t][i];
+
+            if((line >= span->lo) && (line <= span->hi)) c = tr->color[t];
+        }
+        if((c == 0) && tr->reticle && reticle_at(reticle_row(tr->reticle, line), i)) c = 0xffff;
+        *buf++ = c;
+    }
+}
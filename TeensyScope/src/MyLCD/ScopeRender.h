@@ -0,0 +1,88 @@
+/*
+ * ScopeRender.h - Scanline renderers for the scope display
+ *
+ * These functions convert one line of the scope image into RGB565
+ * pixels in LCD order (see LCDPush.h) and are used both by the blocking
+ * draw functions of MyLCD and by the LCDPush engine.
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef ScopeRender_h
+#define ScopeRender_h
+
+#include <stdint.h>
+#include "Reticle.h"
+#include "Palette.h"
+
+/*
+ * The scope image is stored in the order in which the LCD consumes it
+ * in landscape orientation: row major, starting with the top line and
+ * with every line mirrored (rightmost pixel first).
+ * scope_index() returns the position of pixel x,y in the image
+ * where 0,0 is the bottom left corner of the display.
+ */
+static inline int scope_index(int x, int y, int sx, int sy)
+{
+    return ((sy - 1 - y) * sx) + (sx - 1 - x);
+}
+
+typedef struct scope_image_s
+{
+    const uint16_t *data;  // RGB565 image in LCD order
+    int sx, sy;            // Size of the image
+    const reticle_t *reticle; // Reticle drawn where there is no data, 0 = none
+} scope_image_t;
+
+/*
+ * Image of the XY display with an 8 bits intensity per pixel
+ */
+typedef struct scope_xy_image_s
+{
+    const uint8_t *data;      // Intensities in LCD order
+    int sx, sy;               // Size of the image
+    const reticle_t *reticle; // Reticle drawn where the pixel is black, 0 = none
+    const palette_t *palette; // Color for each intensity
+} scope_xy_image_t;
+
+/*
+ * Traces of the time based display, stored per column instead of as an image.
+ * Each column of a trace is a vertical span of image lines (0 = top line),
+ * a column with lo > hi is empty. The columns are in LCD order, use
+ * scope_trace_set() to set the span of column x.
+ */
+#define SCOPE_TRACES        2
+#define SCOPE_TRACE_WIDTH   480
+
+typedef struct scope_span_s
+{
+    uint16_t lo, hi;
+} scope_span_t;
+
+typedef struct scope_trace_s
+{
+    int sx, sy;                  // Size of the image
+    uint16_t color[SCOPE_TRACES];
+    scope_span_t col[SCOPE_TRACES][SCOPE_TRACE_WIDTH];
+    const reticle_t *reticle;    // Reticle drawn where there is no trace, 0 = none
+} scope_trace_t;
+
+void scope_trace_clear(scope_trace_t *tr);
+void scope_trace_clear_column(scope_trace_t *tr, int x);
+
+/*
+ * Set column x of trace t to the span y0..y1 (0,0 is the bottom left corner)
+ */
+static inline void scope_trace_set(scope_trace_t *tr, int t, int x, int y0, int y1)
+{
+    scope_span_t *span = &tr->col[t][tr->sx - 1 - x];
+
+    span->lo = tr->sy - 1 - y1;
+    span->hi = tr->sy - 1 - y0;
+}
+
+void scope_render_xy_line(int line, int len, uint16_t *buf, void *image);
+void scope_render_time_line(int line, int len, uint16_t *buf, void *image);
+void scope_render_trace_line(int line, int len, uint16_t *buf, void *trace);
+void scope_render_trace_column(int col, int len, uint16_t *buf, const scope_trace_t *tr);
+
+#endif
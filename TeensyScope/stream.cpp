@@ -0,0 +1,219 @@
+/*
+ * stream.cpp - Binary sample stream over the USB serial port
+ */
+
+#include <string.h>
+#include "stream.h"
+
+static inline uint32_t record_bytes(uint32_t count, uint8_t bits)
+{
+    return (count * (2 * bits + 1) + 7) / 8;
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+void stream_init(stream_t *s, uint8_t bits)
+{
+    memset(s, 0, sizeof(*s));
+    s->bits = bits;
+}
+
+/*
+ * Close the frame at head and queue it
+ */
+static void close_frame(stream_t *s)
+{
+    stream_frame_t *f = &s->queue[s->head & (STREAM_FRAMES - 1)];
+    uint32_t len = STREAM_HEADER + record_bytes(s->fill, s->bits);
+
+    put16(&f->data[4], s->fill);
+    put16(&f->data[len], stream_check(f->data, len));
+    f->len = len + STREAM_CHECK;
+    s->head++;
+    s->fill = 0;
+}
+
+/*
+ * Open a new frame at head, returns false when the queue is full
+ */
+static bool open_frame(stream_t *s)
+{
+    stream_frame_t *f;
+
+    if((s->head - s->tail) == STREAM_FRAMES) {
+        return false;
+    }
+    f = &s->queue[s->head & (STREAM_FRAMES - 1)];
+    memset(f->data, 0, sizeof(f->data));
+    f->data[0] = STREAM_SYNC0;
+    f->data[1] = STREAM_SYNC1;
+    f->data[2] = s->bits;
+    f->data[3] = s->gap ? STREAM_FLAG_GAP : 0;
+    put16(&f->data[6], s->interval);
+    f->data[8] = s->seq;
+    f->data[9] = s->seq >> 8;
+    f->data[10] = s->seq >> 16;
+    f->data[11] = s->seq >> 24;
+    s->gap = false;
+    s->bitpos = 0;
+    return true;
+}
+
+/*
+ * Start streaming or, when already streaming, continue with a new sample interval.
+ * The samples with the previous interval are sent in their own frame.
+ */
+void stream_start(stream_t *s, uint32_t interval)
+{
+    if(s->on && s->fill) {
+        close_frame(s);
+    }
+    s->interval = interval;
+    s->on = true;
+}
+
+/*
+ * Stop streaming, the samples collected so far are still sent
+ */
+void stream_stop(stream_t *s)
+{
+    if(s->on && s->fill) {
+        close_frame(s);
+    }
+    s->on = false;
+}
+
+/*
+ * Add samples to the stream. Samples that do not fit in the queue are lost.
+ */
+void stream_put(stream_t *s, const sample_t *samples, uint32_t n)
+{
+    uint32_t shift = 2 * s->bits;
+    uint32_t mask = (1UL << s->bits) - 1;
+
+    for(uint32_t i=0; i<n; i++) {
+        stream_frame_t *f = &s->queue[s->head & (STREAM_FRAMES - 1)];
+        uint8_t *p;
+        uint32_t v;
+
+        if((s->fill == 0) && !open_frame(s)) {
+            stream_lose(s, n - i);
+            return;
+        }
+        v = (samples[i].ch1 & mask) | ((samples[i].ch2 & mask) << s->bits) |
+            ((samples[i].ch1 & SAMPLE_TRIGGER) ? 1UL << shift : 0);
+        p = &f->data[STREAM_HEADER + (s->bitpos >> 3)];
+        v <<= s->bitpos & 7;
+        p[0] |= v;
+        p[1] |= v >> 8;
+        p[2] |= v >> 16;
+        p[3] |= v >> 24;
+        s->bitpos += shift + 1;
+        s->seq++;
+        if(++s->fill == STREAM_SAMPLES) {
+            close_frame(s);
+        }
+    }
+}
+
+/*
+ * Count n samples that were lost before they reached the stream
+ */
+void stream_lose(stream_t *s, uint32_t n)
+{
+    if(n == 0) {
+        return;
+    }
+    if(s->fill) {
+        close_frame(s);
+    }
+    s->seq += n;
+    s->lost += n;
+    s->gap = true;
+}
+
+/*
+ * The oldest queued frame, 0 when there is none
+ */
+const stream_frame_t *stream_frame(stream_t *s)
+{
+    if(s->head == s->tail) {
+        return 0;
+    }
+    return &s->queue[s->tail & (STREAM_FRAMES - 1)];
+}
+
+/*
+ * The frame returned by stream_frame() has been sent
+ */
+void stream_sent(stream_t *s)
+{
+    s->tail++;
+    s->frames++;
+}
+
+/*
+ * Fletcher-16
+ */
+uint16_t stream_check(const uint8_t *data, size_t len)
+{
+    uint32_t a = 0, b = 0;
+
+    for(size_t i=0; i<len; i++) {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+/*
+ * Decode the frame at the start of data.
+ * Returns the length of the frame, 0 when more data is needed to decide
+ * or -1 when data does not start with a valid frame.
+ * samples must have room for STREAM_SAMPLES samples.
+ */
+int stream_decode(const uint8_t *data, size_t len, stream_header_t *hdr, sample_t *samples)
+{
+    uint32_t size, pos = 0, shift, mask;
+
+    if((len >= 1) && (data[0] != STREAM_SYNC0)) return -1;
+    if((len >= 2) && (data[1] != STREAM_SYNC1)) return -1;
+    if(len < STREAM_HEADER) return 0;
+
+    hdr->bits = data[2];
+    hdr->flags = data[3];
+    hdr->count = get16(&data[4]);
+    hdr->interval = get16(&data[6]);
+    hdr->seq = data[8] | (data[9] << 8) | (data[10] << 16) | ((uint32_t)data[11] << 24);
+    if((hdr->bits < STREAM_MIN_BITS) || (hdr->bits > STREAM_MAX_BITS) ||
+       (hdr->count == 0) || (hdr->count > STREAM_SAMPLES)) {
+        return -1;
+    }
+    size = STREAM_HEADER + record_bytes(hdr->count, hdr->bits);
+    if(len < size + STREAM_CHECK) return 0;
+    if(get16(&data[size]) != stream_check(data, size)) return -1;
+
+    shift = 2 * hdr->bits;
+    mask = (1UL << hdr->bits) - 1;
+    for(uint32_t i=0; i<hdr->count; i++) {
+        const uint8_t *p = &data[STREAM_HEADER + (pos >> 3)];
+        uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+
+        // The 4th byte is only part of the record when it does not fit in 3
+        if((pos & 7) + shift + 1 > 24) v |= (uint32_t)p[3] << 24;
+        v >>= pos & 7;
+        samples[i].ch1 = (v & mask) | ((v & (1UL << shift)) ? SAMPLE_TRIGGER : 0);
+        samples[i].ch2 = (v >> hdr->bits) & mask;
+        pos += shift + 1;
+    }
+    return size + STREAM_CHECK;
+}
@@ -0,0 +1,93 @@
+/*
+ * stream.h - Binary sample stream over the USB serial port
+ *
+ * The samples taken out of the sample ring are packed into frames that are
+ * sent as a whole, so a host can record the full acquisition rate. A record
+ * holds CH1, CH2 (STREAM_BITS each) and the ModeOP bit, packed LSB first
+ * without padding: 21 bits per sample with the 10 bits ADC.
+ *
+ * Frame layout, all values little endian:
+ *   0  'T' 'S'       sync
+ *   2  bits          ADC bits per channel
+ *   3  flags         STREAM_FLAG_xxx
+ *   4  count         number of samples (uint16)
+ *   6  interval      sample interval in us (uint16)
+ *   8  seq           index of the first sample in the stream (uint32)
+ *  12  records       (count * (2 * bits + 1) + 7) / 8 bytes
+ *   .  check         Fletcher-16 of the header and the records (uint16)
+ *
+ * seq counts every sample, also the ones that were lost in the sample ring
+ * or because the frame queue was full, so a gap in seq shows how many
+ * samples are missing. Text printed by the CLI can end up between two frames,
+ * a decoder finds the next frame by its sync and check.
+ *
+ * The frames are queued in stream_t, loop() sends the oldest one with
+ * stream_frame() and stream_sent() when the serial port has room for it.
+ *
+ * This file does not depend on the Arduino environment so the decoder
+ * on the host uses the same code.
+ */
+
+#ifndef stream_h
+#define stream_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sample_ring.h"
+
+#define STREAM_SYNC0        'T'
+#define STREAM_SYNC1        'S'
+#define STREAM_HEADER       12
+#define STREAM_CHECK        2
+#define STREAM_MIN_BITS     8
+#define STREAM_MAX_BITS     12
+#define STREAM_SAMPLES      256  // Samples per frame
+#define STREAM_FRAMES       16   // Frames in the queue, must be a power of 2
+#define STREAM_FRAME_SIZE   (STREAM_HEADER + (STREAM_SAMPLES * (2 * STREAM_MAX_BITS + 1) + 7) / 8 + STREAM_CHECK)
+
+#define STREAM_FLAG_GAP     0x01 // Samples were lost before this frame
+
+typedef struct stream_frame_s
+{
+    uint16_t len;                      // Bytes in data
+    uint8_t  data[STREAM_FRAME_SIZE];
+} stream_frame_t;
+
+typedef struct stream_s
+{
+    bool     on;
+    uint8_t  bits;
+    uint16_t interval;
+    uint32_t seq;          // Index of the next sample
+    uint32_t lost;         // Samples lost, counted in seq
+    uint32_t frames;       // Frames sent
+    uint32_t head, tail;   // Frames queued and sent
+    uint32_t fill;         // Samples in the frame at head
+    uint32_t bitpos;       // Next bit in the records of the frame at head
+    bool     gap;          // Samples lost since the last queued frame
+    stream_frame_t queue[STREAM_FRAMES];
+} stream_t;
+
+/*
+ * A frame found by stream_decode()
+ */
+typedef struct stream_header_s
+{
+    uint8_t  bits;
+    uint8_t  flags;
+    uint16_t count;
+    uint16_t interval;
+    uint32_t seq;
+} stream_header_t;
+
+void     stream_init(stream_t *s, uint8_t bits);
+void     stream_start(stream_t *s, uint32_t interval);
+void     stream_stop(stream_t *s);
+void     stream_put(stream_t *s, const sample_t *samples, uint32_t n);
+void     stream_lose(stream_t *s, uint32_t n);
+const stream_frame_t *stream_frame(stream_t *s);
+void     stream_sent(stream_t *s);
+uint16_t stream_check(const uint8_t *data, size_t len);
+int      stream_decode(const uint8_t *data, size_t len, stream_header_t *hdr, sample_t *samples);
+
+#endif
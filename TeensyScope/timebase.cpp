@@ -0,0 +1,104 @@
+/*
+ * timebase.cpp - Time base for the time based display
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timebase.h"
+
+/*
+ * Set the time base to us_div us per division.
+ * The sample interval is the time of one pixel, limited to
+ * TIMEBASE_MIN_INTERVAL .. TIMEBASE_MAX_INTERVAL. Below 1 us/pixel
+ * each sample moves the trace more than one pixel.
+ * Returns false when the setting is out of range.
+ */
+bool timebase_set(timebase_t *tb, uint32_t us_div, uint32_t px_per_div)
+{
+    uint32_t interval;
+
+    if((us_div < TIMEBASE_MIN_DIV) || (us_div > TIMEBASE_MAX_DIV)) {
+        return false;
+    }
+    interval = us_div / px_per_div;
+    if(interval < TIMEBASE_MIN_INTERVAL) interval = TIMEBASE_MIN_INTERVAL;
+    if(interval > TIMEBASE_MAX_INTERVAL) interval = TIMEBASE_MAX_INTERVAL;
+
+    tb->us_div = us_div;
+    tb->interval = interval;
+    tb->step = interval * px_per_div;
+    tb->acc = 0;
+    return true;
+}
+
+/*
+ * Parse a time per division like "2.5ms", "100us" or "1s".
+ * A number without a unit is in ms.
+ * Returns the time in us or 0 when the value is not valid.
+ */
+uint32_t timebase_parse(const char *s)
+{
+    char *unit;
+    double val = strtod(s, &unit);
+    double scale;
+
+    if((unit == s) || (val <= 0)) {
+        return 0;
+    }
+    if((*unit == '\0') || (strcmp(unit, "ms") == 0)) {
+        scale = 1000.0;
+    } else if(strcmp(unit, "us") == 0) {
+        scale = 1.0;
+    } else if(strcmp(unit, "s") == 0) {
+        scale = 1000000.0;
+    } else {
+        return 0;
+    }
+    val = val * scale + 0.5;
+    if(val > TIMEBASE_MAX_DIV) {
+        return 0;
+    }
+    return (uint32_t)val;
+}
+
+/*
+ * Next setting in the 1-2-5 sequence above (dir > 0) or below (dir < 0) us_div.
+ * Returns us_div when there is no next setting.
+ */
+uint32_t timebase_next(uint32_t us_div, int dir)
+{
+    static const uint8_t steps[3] = {1, 2, 5};
+    uint32_t decade;
+    uint32_t next = us_div;
+
+    for(decade = 1; decade <= TIMEBASE_MAX_DIV; decade *= 10) {
+        for(int i=0; i<3; i++) {
+            uint32_t val = steps[i] * decade;
+
+            if((val < TIMEBASE_MIN_DIV) || (val > TIMEBASE_MAX_DIV)) {
+                continue;
+            }
+            if(dir > 0) {
+                if(val > us_div) return val;
+            } else if(val < us_div) {
+                next = val;
+            }
+        }
+    }
+    return next;
+}
+
+/*
+ * Print a time in us with a readable unit, e.g. "2.5 ms"
+ */
+void timebase_format(uint32_t us, char *buf, size_t len)
+{
+    if(us >= 1000000) {
+        snprintf(buf, len, "%g s", us / 1000000.0);
+    } else if(us >= 1000) {
+        snprintf(buf, len, "%g ms", us / 1000.0);
+    } else {
+        snprintf(buf, len, "%u us", (unsigned int)us);
+    }
+}
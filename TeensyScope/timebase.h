@@ -0,0 +1,64 @@
+/*
+ * timebase.h - Time base for the time based display
+ *
+ * A time base setting is the time per division in us. It selects the
+ * sample interval and the number of pixels each sample moves the trace.
+ *
+ * The position of the trace is kept as a fraction: every sample adds
+ * interval * px_per_div to an accumulator and the trace moves one pixel
+ * for every us_div in the accumulator. This is exact for every setting,
+ * so a division is always px_per_div pixels wide, also for settings like
+ * 2.5 ms/div or 100 us/div where a pixel is not a whole number of samples.
+ *
+ * This file does not depend on the Arduino environment.
+ */
+
+#ifndef timebase_h
+#define timebase_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TIMEBASE_MIN_DIV       10       // us/div
+#define TIMEBASE_MAX_DIV       5000000  // us/div (5 s/div)
+#define TIMEBASE_MAX_INTERVAL  25       // us, longest sample interval used in time mode
+#define TIMEBASE_MIN_INTERVAL  1        // us, shortest sample interval
+
+typedef struct timebase_s
+{
+    uint32_t us_div;    // Time per division in us
+    uint32_t interval;  // Sample interval in us
+    uint32_t step;      // Added to acc for every sample (interval * px_per_div)
+    uint32_t acc;       // Fraction of a pixel, in units of 1/us_div
+} timebase_t;
+
+bool     timebase_set(timebase_t *tb, uint32_t us_div, uint32_t px_per_div);
+uint32_t timebase_parse(const char *s);
+uint32_t timebase_next(uint32_t us_div, int dir);
+void     timebase_format(uint32_t us, char *buf, size_t len);
+
+/*
+ * Start a new sweep
+ */
+static inline void timebase_restart(timebase_t *tb)
+{
+    tb->acc = 0;
+}
+
+/*
+ * Number of pixels the trace moves after a sample.
+ * This is 0 when more than one sample goes into a pixel.
+ */
+static inline uint32_t timebase_advance(timebase_t *tb)
+{
+    uint32_t px = 0;
+
+    tb->acc += tb->step;
+    while(tb->acc >= tb->us_div) {
+        tb->acc -= tb->us_div;
+        px++;
+    }
+    return px;
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*
+ * trigger.cpp - Trigger engine for the time based display
+ */
+
+#include "trigger.h"
+
+/*
+ * Default settings: falling edge on the ModeOP input without pre-trigger
+ */
+void trigger_init(trigger_t *tr)
+{
+    tr->source = TRIGGER_SRC_EXT;
+    tr->slope = TRIGGER_FALLING;
+    tr->mode = TRIGGER_NORMAL;
+    tr->pre = 0;
+    tr->level = 512;
+    tr->hysteresis = 16;
+    tr->fired = false;
+    trigger_update(tr);
+    trigger_arm(tr, 0, 0);
+}
+
+/*
+ * Calculate the thresholds after changing the settings
+ */
+void trigger_update(trigger_t *tr)
+{
+    if(tr->source == TRIGGER_SRC_EXT) {
+        tr->hi = 1;
+        tr->lo = 0;
+    } else {
+        uint32_t half = tr->hysteresis / 2;
+
+        tr->hi = tr->level + half;
+        tr->lo = (tr->level > half) ? tr->level - half : 0;
+        if(tr->hi <= tr->lo) tr->hi = tr->lo + 1;
+    }
+}
+
+/*
+ * Arm the trigger for a new sweep.
+ * Edges are ignored during the first holdoff samples (at least the first
+ * sample, which sets the initial state). In AUTO mode the trigger fires
+ * by itself after timeout samples.
+ */
+void trigger_arm(trigger_t *tr, uint32_t holdoff, uint32_t timeout)
+{
+    tr->count = 0;
+    tr->state = 0;
+    tr->holdoff = (holdoff < 1) ? 1 : holdoff;
+    tr->timeout = (tr->mode == TRIGGER_AUTO) ? ((timeout > tr->holdoff) ? timeout : tr->holdoff + 1) : 0;
+}
+
+/*
+ * Allow a SINGLE mode trigger to fire again
+ */
+void trigger_rearm(trigger_t *tr)
+{
+    tr->fired = false;
+}
@@ -0,0 +1,94 @@
+/*
+ * trigger.h - Trigger engine for the time based display
+ *
+ * The trigger looks at every sample and fires on an edge of the selected source:
+ *  - CH1 or CH2: a Schmitt trigger on the ADC value. The signal is high after
+ *                it went above level + hysteresis/2 and low after it went below
+ *                level - hysteresis/2, so noise around the level does not trigger.
+ *  - EXT:        the digital trigger input (ModeOP).
+ * The slope selects rising, falling or either edge.
+ *
+ * Modes:
+ *  - AUTO:   as NORMAL, but the trigger fires by itself when there is no edge
+ *            within the timeout, so a signal without edges is still shown
+ *  - NORMAL: only fire on an edge
+ *  - SINGLE: fire once on an edge, trigger_rearm() arms it again
+ *
+ * After arming, edges are ignored for a hold off number of samples. This is
+ * used to collect the pre-trigger part of the sweep before triggering.
+ *
+ * The edge detection is done without branches. This file does not
+ * depend on the Arduino environment so it can be tested on a host.
+ */
+
+#ifndef trigger_h
+#define trigger_h
+
+#include <stdint.h>
+#include "sample_ring.h"
+
+#define TRIGGER_SRC_CH1     0
+#define TRIGGER_SRC_CH2     1
+#define TRIGGER_SRC_EXT     2
+
+#define TRIGGER_RISING      1
+#define TRIGGER_FALLING     2
+#define TRIGGER_EITHER      (TRIGGER_RISING | TRIGGER_FALLING)
+
+#define TRIGGER_AUTO        0
+#define TRIGGER_NORMAL      1
+#define TRIGGER_SINGLE      2
+
+#define TRIGGER_MAX_PRE     90   // Max. pre-trigger in % of the sweep
+
+typedef struct trigger_s
+{
+    // Settings
+    uint8_t  source;
+    uint8_t  slope;
+    uint8_t  mode;
+    uint8_t  pre;          // Pre-trigger in % of the sweep
+    uint16_t level;
+    uint16_t hysteresis;
+
+    // State
+    uint32_t hi, lo;       // Schmitt trigger thresholds
+    uint32_t state;        // 1 when the source is high
+    uint32_t count;        // Samples since arming
+    uint32_t holdoff;      // Samples before an edge is accepted
+    uint32_t timeout;      // AUTO mode: samples until the trigger fires by itself
+    bool     fired;        // SINGLE mode: the trigger has fired
+} trigger_t;
+
+void trigger_init(trigger_t *tr);
+void trigger_update(trigger_t *tr);
+void trigger_arm(trigger_t *tr, uint32_t holdoff, uint32_t timeout);
+void trigger_rearm(trigger_t *tr);
+
+/*
+ * Feed a sample to the trigger.
+ * Returns true when the trigger fires on this sample.
+ */
+static inline bool trigger_sample(trigger_t *tr, sample_t s)
+{
+    uint32_t val, above, below, state, edges, fire;
+
+    // Select the source, EXT uses the values 0 and 1
+    val = (tr->source == TRIGGER_SRC_EXT) ? (s.ch1 >> 15) :
+          ((tr->source == TRIGGER_SRC_CH1) ? s.ch1 : s.ch2) & SAMPLE_VALUE;
+
+    above = (val >= tr->hi);
+    below = (val <= tr->lo);
+    state = (tr->state & (below ^ 1)) | above;
+    edges = (state & ~tr->state) | ((tr->state & ~state) << 1); // Bit 0 rising, bit 1 falling
+    tr->state = state;
+    tr->count++;
+
+    fire = ((edges & tr->slope) != 0) & (tr->count > tr->holdoff);
+    fire |= (tr->timeout != 0) & (tr->count >= tr->timeout);
+    fire &= !tr->fired;
+    tr->fired |= fire & (tr->mode == TRIGGER_SINGLE);
+    return fire;
+}
+
+#endif